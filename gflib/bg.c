@@ -192,7 +192,11 @@ u8 LoadBgVram(u8 bg, const void *src, u16 size, u16 destOffset, u8 mode)
 
         offset = destOffset + offset;
 
+#ifdef FAST_DMA3
+        cursor = RequestDma3CopyWithPriority(src, (void*)(offset + BG_VRAM), size, 0, mode == 0x2 ? DMA3_PRIORITY_TILEMAP : DMA3_PRIORITY_BULK);
+#else
         cursor = RequestDma3Copy(src, (void*)(offset + BG_VRAM), size, 0);
+#endif
 
         if (cursor == -1)
         {
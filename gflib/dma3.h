@@ -46,10 +46,37 @@
 #define Dma3FillLarge16_(value, dest, size) Dma3FillLarge_(value, dest, size, 16)
 #define Dma3FillLarge32_(value, dest, size) Dma3FillLarge_(value, dest, size, 32)
 
+#ifdef FAST_DMA3
+// Every waiting request of one priority is transferred before any of the
+// next. Requests that don't say otherwise get DMA3_PRIORITY_SPRITE if they
+// write to OBJ VRAM, DMA3_PRIORITY_TILEMAP if they write to palette RAM and
+// DMA3_PRIORITY_BULK if they write anywhere else.
+#define DMA3_PRIORITY_TILEMAP 0
+#define DMA3_PRIORITY_SPRITE  1
+#define DMA3_PRIORITY_BULK    2
+#define DMA3_NUM_PRIORITIES   3
+
+// Counts for the last frame's ProcessDma3Requests.
+struct Dma3Stats
+{
+    u32 bytesQueued;      // requested since the frame before
+    u32 bytesTransferred;
+    u32 bytesDeferred;    // still waiting for a later frame
+    u32 bytesSuperseded;  // replaced by a later request to the same place
+    u32 bytesDropped;     // refused because the queue was full
+    u16 requestsMerged;   // appended to the request before them
+};
+
+extern struct Dma3Stats gDma3Stats;
+#endif // FAST_DMA3
+
 void ClearDma3Requests(void);
 void ProcessDma3Requests(void);
 s16 RequestDma3Copy(const void *src, void *dest, u16 size, u8 mode);
 s16 RequestDma3Fill(s32 value, void *dest, u16 size, u8 mode);
+#ifdef FAST_DMA3
+s16 RequestDma3CopyWithPriority(const void *src, void *dest, u16 size, u8 mode, u8 priority);
+#endif
 s16 CheckForSpaceForDma3Request(s16 index);
 
 #endif // GUARD_DMA3_H
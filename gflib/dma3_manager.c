@@ -8,6 +8,358 @@
 #define DMA_REQUEST_COPY16 3
 #define DMA_REQUEST_FILL16 4
 
+#ifdef FAST_DMA3
+#define DMA3_NO_REQUEST 0xFF
+#define DMA3_BYTES_PER_FRAME (40 * 1024)
+
+BSS_DATA struct
+{
+    const u8 *src;
+    u8 *dest;
+    u16 size;
+    u16 mode;
+    u32 value;
+    u8 priority;
+    u8 next; // next request in the same priority's queue or superseded list
+    u8 superseded; // first of the requests this one replaced, which wait for it
+} gDma3Requests[MAX_DMA_REQUESTS];
+
+static volatile bool8 gDma3ManagerLocked;
+static u8 gDma3RequestCursor; // where to start looking for a free request
+static u8 sDma3QueueHeads[DMA3_NUM_PRIORITIES];
+static u8 sDma3QueueTails[DMA3_NUM_PRIORITIES];
+static u32 sDma3BytesPending;
+static struct Dma3Stats sDma3FrameStats;
+struct Dma3Stats gDma3Stats;
+
+static void FreeDma3Request(int index)
+{
+    gDma3Requests[index].src = NULL;
+    gDma3Requests[index].dest = NULL;
+    gDma3Requests[index].size = 0;
+    gDma3Requests[index].mode = 0;
+    gDma3Requests[index].value = 0;
+    gDma3Requests[index].next = DMA3_NO_REQUEST;
+    gDma3Requests[index].superseded = DMA3_NO_REQUEST;
+}
+
+// Requests that were superseded by the one at index are finished once it is.
+static void FreeSupersededDma3Requests(int index)
+{
+    int i = gDma3Requests[index].superseded;
+
+    while (i != DMA3_NO_REQUEST)
+    {
+        int next = gDma3Requests[i].next;
+
+        FreeDma3Request(i);
+        i = next;
+    }
+}
+
+void ClearDma3Requests(void)
+{
+    int i;
+
+    gDma3ManagerLocked = TRUE;
+    gDma3RequestCursor = 0;
+
+    for (i = 0; i < MAX_DMA_REQUESTS; i++)
+        FreeDma3Request(i);
+
+    for (i = 0; i < DMA3_NUM_PRIORITIES; i++)
+    {
+        sDma3QueueHeads[i] = DMA3_NO_REQUEST;
+        sDma3QueueTails[i] = DMA3_NO_REQUEST;
+    }
+
+    sDma3BytesPending = 0;
+    memset(&sDma3FrameStats, 0, sizeof(sDma3FrameStats));
+    memset(&gDma3Stats, 0, sizeof(gDma3Stats));
+
+    gDma3ManagerLocked = FALSE;
+}
+
+void ProcessDma3Requests(void)
+{
+    u32 bytesTransferred;
+    int priority;
+
+    if (gDma3ManagerLocked)
+        return;
+
+    bytesTransferred = 0;
+
+    for (priority = 0; priority < DMA3_NUM_PRIORITIES; priority++)
+    {
+        while (sDma3QueueHeads[priority] != DMA3_NO_REQUEST)
+        {
+            int index = sDma3QueueHeads[priority];
+
+            if (bytesTransferred + gDma3Requests[index].size > DMA3_BYTES_PER_FRAME)
+                goto done; // don't transfer more than 40 KiB
+            if (*(u8 *)REG_ADDR_VCOUNT > 224)
+                goto done; // we're about to leave vblank, stop
+
+            bytesTransferred += gDma3Requests[index].size;
+
+            switch (gDma3Requests[index].mode)
+            {
+            case DMA_REQUEST_COPY32:
+                Dma3CopyLarge32_(gDma3Requests[index].src, gDma3Requests[index].dest, gDma3Requests[index].size);
+                break;
+            case DMA_REQUEST_FILL32:
+                Dma3FillLarge32_(gDma3Requests[index].value, gDma3Requests[index].dest, gDma3Requests[index].size);
+                break;
+            case DMA_REQUEST_COPY16:
+                Dma3CopyLarge16_(gDma3Requests[index].src, gDma3Requests[index].dest, gDma3Requests[index].size);
+                break;
+            case DMA_REQUEST_FILL16:
+                Dma3FillLarge16_(gDma3Requests[index].value, gDma3Requests[index].dest, gDma3Requests[index].size);
+                break;
+            }
+
+            sDma3QueueHeads[priority] = gDma3Requests[index].next;
+            if (sDma3QueueHeads[priority] == DMA3_NO_REQUEST)
+                sDma3QueueTails[priority] = DMA3_NO_REQUEST;
+
+            sDma3BytesPending -= gDma3Requests[index].size;
+            FreeSupersededDma3Requests(index);
+            FreeDma3Request(index);
+        }
+    }
+
+done:
+    sDma3FrameStats.bytesTransferred = bytesTransferred;
+    sDma3FrameStats.bytesDeferred = sDma3BytesPending;
+    gDma3Stats = sDma3FrameStats;
+    memset(&sDma3FrameStats, 0, sizeof(sDma3FrameStats));
+}
+
+static bool32 RangesOverlap(const void *a, u32 sizeA, const void *b, u32 sizeB)
+{
+    return (u32)a < (u32)b + sizeB && (u32)b < (u32)a + sizeA;
+}
+
+static u8 GetDefaultDma3Priority(const void *dest)
+{
+    if ((u32)dest >= PLTT && (u32)dest < PLTT + PLTT_SIZE)
+        return DMA3_PRIORITY_TILEMAP;
+    if ((u32)dest >= OBJ_VRAM0 && (u32)dest < VRAM + VRAM_SIZE)
+        return DMA3_PRIORITY_SPRITE;
+    return DMA3_PRIORITY_BULK;
+}
+
+// Whether the waiting request at index has to happen before a new request
+// that reads from src and writes to dest: either one writes where the other
+// writes or reads.
+static bool32 IsDma3RequestOrdered(int index, const void *src, void *dest, u16 size)
+{
+    if (RangesOverlap(gDma3Requests[index].dest, gDma3Requests[index].size, dest, size))
+        return TRUE;
+    if (src != NULL && RangesOverlap(gDma3Requests[index].dest, gDma3Requests[index].size, src, size))
+        return TRUE;
+    if (gDma3Requests[index].src != NULL && RangesOverlap(gDma3Requests[index].src, gDma3Requests[index].size, dest, size))
+        return TRUE;
+    return FALSE;
+}
+
+// Whether anything reads from where the request at index writes, either a
+// waiting request or the new one reading from src.
+static bool32 IsDma3RequestDestRead(int index, const void *src, u16 size)
+{
+    int priority;
+    int i;
+
+    if (src != NULL && RangesOverlap(gDma3Requests[index].dest, gDma3Requests[index].size, src, size))
+        return TRUE;
+
+    for (priority = 0; priority < DMA3_NUM_PRIORITIES; priority++)
+    {
+        for (i = sDma3QueueHeads[priority]; i != DMA3_NO_REQUEST; i = gDma3Requests[i].next)
+        {
+            if (gDma3Requests[i].src != NULL
+             && RangesOverlap(gDma3Requests[index].dest, gDma3Requests[index].size, gDma3Requests[i].src, gDma3Requests[i].size))
+                return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+// Takes the request at index, which follows prev in its queue, out of the
+// queue and has it wait for the request at replacement instead, along with
+// any requests it had itself replaced.
+static void SupersedeDma3Request(int index, int prev, int replacement)
+{
+    int priority = gDma3Requests[index].priority;
+    int last = gDma3Requests[index].superseded;
+
+    if (prev == DMA3_NO_REQUEST)
+        sDma3QueueHeads[priority] = gDma3Requests[index].next;
+    else
+        gDma3Requests[prev].next = gDma3Requests[index].next;
+
+    if (sDma3QueueTails[priority] == index)
+        sDma3QueueTails[priority] = prev;
+
+    if (last != DMA3_NO_REQUEST)
+    {
+        while (gDma3Requests[last].next != DMA3_NO_REQUEST)
+            last = gDma3Requests[last].next;
+
+        gDma3Requests[last].next = gDma3Requests[replacement].superseded;
+        gDma3Requests[replacement].superseded = gDma3Requests[index].superseded;
+        gDma3Requests[index].superseded = DMA3_NO_REQUEST;
+    }
+
+    sDma3BytesPending -= gDma3Requests[index].size;
+    gDma3Requests[index].next = gDma3Requests[replacement].superseded;
+    gDma3Requests[replacement].superseded = index;
+}
+
+static s16 QueueDma3Request(const void *src, void *dest, u16 size, u16 mode, u32 value, u8 priority)
+{
+    u32 start = (u32)dest;
+    u32 end = start + size;
+    bool32 merge = FALSE;
+    int cursor;
+    int prev;
+    int p;
+    int i;
+
+    gDma3ManagerLocked = TRUE;
+
+    sDma3FrameStats.bytesQueued += size;
+
+    // A request can't be moved ahead of an earlier one that writes where it
+    // writes or reads, or that reads where it writes, so it has to wait in
+    // the later of the two queues.
+    for (p = DMA3_NUM_PRIORITIES - 1; p > priority; p--)
+    {
+        for (i = sDma3QueueHeads[p]; i != DMA3_NO_REQUEST; i = gDma3Requests[i].next)
+        {
+            if (IsDma3RequestOrdered(i, src, dest, size))
+                break;
+        }
+
+        if (i != DMA3_NO_REQUEST)
+        {
+            priority = p;
+            break;
+        }
+    }
+
+    // Append the request to the last one in its queue if it carries straight on
+    // from it.
+    cursor = sDma3QueueTails[priority];
+
+    if (cursor != DMA3_NO_REQUEST
+     && gDma3Requests[cursor].mode == mode
+     && (u32)gDma3Requests[cursor].dest + gDma3Requests[cursor].size == start
+     && gDma3Requests[cursor].size + size <= DMA3_BYTES_PER_FRAME)
+    {
+        if (mode == DMA_REQUEST_FILL32 || mode == DMA_REQUEST_FILL16)
+            merge = (gDma3Requests[cursor].value == value);
+        else
+            merge = (gDma3Requests[cursor].src + gDma3Requests[cursor].size == src);
+    }
+
+    if (!merge)
+    {
+        cursor = gDma3RequestCursor;
+
+        for (i = 0; i < MAX_DMA_REQUESTS; i++)
+        {
+            if (gDma3Requests[cursor].size == 0) // an empty request was found.
+                break;
+            if (++cursor >= MAX_DMA_REQUESTS) // loop back to start.
+                cursor = 0;
+        }
+
+        if (i == MAX_DMA_REQUESTS)
+        {
+            sDma3FrameStats.bytesDropped += size;
+            gDma3ManagerLocked = FALSE;
+            return -1;  // no free DMA request was found
+        }
+
+        gDma3Requests[cursor].superseded = DMA3_NO_REQUEST;
+    }
+
+    // Earlier requests that this one completely overwrites don't need to
+    // happen at all, as long as nothing reads what they write. They count as
+    // waiting until this request is done.
+    for (p = 0; p < DMA3_NUM_PRIORITIES; p++)
+    {
+        prev = DMA3_NO_REQUEST;
+        i = sDma3QueueHeads[p];
+
+        while (i != DMA3_NO_REQUEST)
+        {
+            int next = gDma3Requests[i].next;
+            u32 otherStart = (u32)gDma3Requests[i].dest;
+
+            if (i != cursor
+             && otherStart >= start && otherStart + gDma3Requests[i].size <= end
+             && !IsDma3RequestDestRead(i, src, size))
+            {
+                sDma3FrameStats.bytesSuperseded += gDma3Requests[i].size;
+                SupersedeDma3Request(i, prev, cursor);
+            }
+            else
+            {
+                prev = i;
+            }
+
+            i = next;
+        }
+    }
+
+    if (merge)
+    {
+        gDma3Requests[cursor].size += size;
+        sDma3BytesPending += size;
+        sDma3FrameStats.requestsMerged++;
+        gDma3ManagerLocked = FALSE;
+        return cursor;
+    }
+
+    gDma3Requests[cursor].src = src;
+    gDma3Requests[cursor].dest = dest;
+    gDma3Requests[cursor].size = size;
+    gDma3Requests[cursor].mode = mode;
+    gDma3Requests[cursor].value = value;
+    gDma3Requests[cursor].priority = priority;
+    gDma3Requests[cursor].next = DMA3_NO_REQUEST;
+
+    if (sDma3QueueTails[priority] == DMA3_NO_REQUEST)
+        sDma3QueueHeads[priority] = cursor;
+    else
+        gDma3Requests[sDma3QueueTails[priority]].next = cursor;
+    sDma3QueueTails[priority] = cursor;
+
+    sDma3BytesPending += size;
+    gDma3RequestCursor = (cursor + 1) % MAX_DMA_REQUESTS;
+    gDma3ManagerLocked = FALSE;
+    return cursor;
+}
+
+s16 RequestDma3CopyWithPriority(const void *src, void *dest, u16 size, u8 mode, u8 priority)
+{
+    return QueueDma3Request(src, dest, size, mode == 1 ? DMA_REQUEST_COPY32 : DMA_REQUEST_COPY16, 0, priority);
+}
+
+s16 RequestDma3Copy(const void *src, void *dest, u16 size, u8 mode)
+{
+    return RequestDma3CopyWithPriority(src, dest, size, mode, GetDefaultDma3Priority(dest));
+}
+
+s16 RequestDma3Fill(s32 value, void *dest, u16 size, u8 mode)
+{
+    return QueueDma3Request(NULL, dest, size, mode == 1 ? DMA_REQUEST_FILL32 : DMA_REQUEST_FILL16, value, GetDefaultDma3Priority(dest));
+}
+#else
 BSS_DATA struct
 {
     const u8 *src;
@@ -157,6 +509,7 @@ s16 RequestDma3Fill(s32 value, void *dest, u16 size, u8 mode)
     gDma3ManagerLocked = FALSE;
     return -1;  // no free DMA request was found
 }
+#endif // FAST_DMA3
 
 s16 CheckForSpaceForDma3Request(s16 index)
 {
@@ -26,6 +26,110 @@ struct MemBlock {
     u8 data[0];
 };
 
+#ifdef FAST_MALLOC
+// Free blocks are also kept in lists by size, so that allocating doesn't have
+// to walk every block in the heap. The links live in the free block's data.
+// There's only one set of lists, so this only supports one heap at a time.
+struct FreeMemBlockLinks {
+    struct MemBlock *prev;
+    struct MemBlock *next;
+};
+
+#define FREE_LINKS(block) ((struct FreeMemBlockLinks *)(block)->data)
+
+// Every block must be able to hold the links once it's freed.
+#define MIN_BLOCK_SIZE sizeof(struct FreeMemBlockLinks)
+
+// Blocks smaller than this each have a bin for their exact size, and the
+// larger ones are binned by powers of two.
+#define SMALL_BIN_LIMIT 256
+#define NUM_SMALL_BINS (SMALL_BIN_LIMIT / 4)
+#define NUM_BINS (NUM_SMALL_BINS + 10)
+
+static struct MemBlock *sFreeBins[NUM_BINS];
+static u32 sNonEmptyBins[(NUM_BINS + 31) / 32];
+
+static u32 GetBin(u32 size)
+{
+    u32 bin;
+
+    if (size < SMALL_BIN_LIMIT)
+        return size / 4;
+
+    bin = NUM_SMALL_BINS;
+    size /= SMALL_BIN_LIMIT * 2;
+
+    while (size != 0 && bin < NUM_BINS - 1) {
+        size >>= 1;
+        bin++;
+    }
+
+    return bin;
+}
+
+static void AddFreeBlock(struct MemBlock *block)
+{
+    u32 bin = GetBin(block->size);
+    struct MemBlock *next = sFreeBins[bin];
+
+    FREE_LINKS(block)->prev = NULL;
+    FREE_LINKS(block)->next = next;
+
+    if (next != NULL)
+        FREE_LINKS(next)->prev = block;
+
+    sFreeBins[bin] = block;
+    sNonEmptyBins[bin / 32] |= 1u << (bin % 32);
+}
+
+static void RemoveFreeBlock(struct MemBlock *block)
+{
+    u32 bin = GetBin(block->size);
+    struct MemBlock *prev = FREE_LINKS(block)->prev;
+    struct MemBlock *next = FREE_LINKS(block)->next;
+
+    if (prev != NULL)
+        FREE_LINKS(prev)->next = next;
+    else
+        sFreeBins[bin] = next;
+
+    if (next != NULL)
+        FREE_LINKS(next)->prev = prev;
+
+    if (sFreeBins[bin] == NULL)
+        sNonEmptyBins[bin / 32] &= ~(1u << (bin % 32));
+}
+
+// Returns the first bin from bin onwards that has a free block in it, or
+// NUM_BINS if there isn't one.
+static u32 FindNonEmptyBin(u32 bin)
+{
+    u32 word;
+    u32 bits;
+
+    if (bin >= NUM_BINS)
+        return NUM_BINS;
+
+    word = bin / 32;
+    bits = sNonEmptyBins[word] & ~((1u << (bin % 32)) - 1);
+
+    while (bits == 0) {
+        if (++word == ARRAY_COUNT(sNonEmptyBins))
+            return NUM_BINS;
+        bits = sNonEmptyBins[word];
+    }
+
+    bin = word * 32;
+
+    while (!(bits & 1)) {
+        bits >>= 1;
+        bin++;
+    }
+
+    return bin;
+}
+#endif // FAST_MALLOC
+
 void PutMemBlockHeader(void *block, struct MemBlock *prev, struct MemBlock *next, u32 size)
 {
     struct MemBlock *header = (struct MemBlock *)block;
@@ -42,6 +146,119 @@ void PutFirstMemBlockHeader(void *block, u32 size)
     PutMemBlockHeader(block, (struct MemBlock *)block, (struct MemBlock *)block, size - sizeof(struct MemBlock));
 }
 
+#ifdef FAST_MALLOC
+void *AllocInternal(void *heapStart, u32 size)
+{
+    struct MemBlock *head = (struct MemBlock *)heapStart;
+    struct MemBlock *pos;
+    struct MemBlock *splitBlock;
+    u32 foundBlockSize;
+    u32 bin;
+
+    // Alignment
+    if (size & 3)
+        size = 4 * ((size / 4) + 1);
+
+    if (size < MIN_BLOCK_SIZE)
+        size = MIN_BLOCK_SIZE;
+
+    bin = GetBin(size);
+
+    // Every block in a small bin is the same size, and every block in a
+    // later bin is bigger. Large bins hold a range of sizes, so take the
+    // smallest block that fits to keep the bigger ones whole.
+    pos = NULL;
+
+    if (bin < NUM_SMALL_BINS) {
+        bin = FindNonEmptyBin(bin);
+
+        if (bin < NUM_SMALL_BINS)
+            pos = sFreeBins[bin];
+    }
+
+    for (; pos == NULL && bin < NUM_BINS; bin = FindNonEmptyBin(bin + 1)) {
+        struct MemBlock *block;
+
+        for (block = sFreeBins[bin]; block != NULL; block = FREE_LINKS(block)->next) {
+            if (block->size >= size && (pos == NULL || block->size < pos->size))
+                pos = block;
+        }
+    }
+
+    if (pos == NULL)
+        return NULL;
+
+    RemoveFreeBlock(pos);
+    foundBlockSize = pos->size;
+
+    if (foundBlockSize - size < 2 * sizeof(struct MemBlock)) {
+        // The block isn't much bigger than the requested size,
+        // so just use it.
+        pos->flag = TRUE;
+    } else {
+        // The block is significantly bigger than the requested
+        // size, so split the rest into a separate block.
+        foundBlockSize -= sizeof(struct MemBlock);
+        foundBlockSize -= size;
+
+        splitBlock = (struct MemBlock *)(pos->data + size);
+
+        pos->flag = TRUE;
+        pos->size = size;
+
+        PutMemBlockHeader(splitBlock, pos, pos->next, foundBlockSize);
+
+        pos->next = splitBlock;
+
+        if (splitBlock->next != head)
+            splitBlock->next->prev = splitBlock;
+
+        AddFreeBlock(splitBlock);
+    }
+
+    return pos->data;
+}
+
+void FreeInternal(void *heapStart, void *pointer)
+{
+    if (pointer) {
+        struct MemBlock *head = (struct MemBlock *)heapStart;
+        struct MemBlock *block = (struct MemBlock *)((u8 *)pointer - sizeof(struct MemBlock));
+        block->flag = FALSE;
+
+        // If the freed block isn't the last one, merge with the next block
+        // if it's not in use.
+        if (block->next != head) {
+            if (!block->next->flag) {
+                RemoveFreeBlock(block->next);
+                block->size += sizeof(struct MemBlock) + block->next->size;
+                block->next->magic = 0;
+                block->next = block->next->next;
+                if (block->next != head)
+                    block->next->prev = block;
+            }
+        }
+
+        // If the freed block isn't the first one, merge with the previous block
+        // if it's not in use.
+        if (block != head) {
+            if (!block->prev->flag) {
+                RemoveFreeBlock(block->prev);
+                block->prev->next = block->next;
+
+                if (block->next != head)
+                    block->next->prev = block->prev;
+
+                block->magic = 0;
+                block->prev->size += sizeof(struct MemBlock) + block->size;
+                block = block->prev;
+            }
+        }
+
+        AddFreeBlock(block);
+    }
+}
+#else
 void *AllocInternal(void *heapStart, u32 size)
 {
     struct MemBlock *pos = (struct MemBlock *)heapStart;
@@ -128,6 +345,7 @@ void FreeInternal(void *heapStart, void *pointer)
         }
     }
 }
+#endif // FAST_MALLOC
 
 void *AllocZeroedInternal(void *heapStart, u32 size)
 {
@@ -166,6 +384,19 @@ bool32 CheckMemBlockInternal(void *heapStart, void *pointer)
     if (block->next != head && block->next != (struct MemBlock *)(block->data + block->size))
         return FALSE;
 
+#ifdef FAST_MALLOC
+    if (!block->flag) {
+        struct MemBlock *prev = FREE_LINKS(block)->prev;
+        struct MemBlock *next = FREE_LINKS(block)->next;
+
+        if (prev != NULL ? FREE_LINKS(prev)->next != block : sFreeBins[GetBin(block->size)] != block)
+            return FALSE;
+
+        if (next != NULL && FREE_LINKS(next)->prev != block)
+            return FALSE;
+    }
+#endif
+
     return TRUE;
 }
 
@@ -174,6 +405,11 @@ void InitHeap(void *heapStart, u32 heapSize)
     sHeapStart = heapStart;
     sHeapSize = heapSize;
     PutFirstMemBlockHeader(heapStart, heapSize);
+#ifdef FAST_MALLOC
+    CpuFill32(0, sFreeBins, sizeof(sFreeBins));
+    CpuFill32(0, sNonEmptyBins, sizeof(sNonEmptyBins));
+    AddFreeBlock(heapStart);
+#endif
 }
 
 void *Alloc(u32 size)
@@ -208,3 +444,96 @@ bool32 CheckHeap()
 
     return TRUE;
 }
+
+#ifdef HEAP_ARENAS
+struct Arena {
+    // Size of the arena's data, not including this header struct.
+    u32 size;
+
+    // Number of bytes handed out since the arena was created or reset.
+    u32 used;
+
+    // The most bytes that were ever in use at once.
+    u32 highWaterMark;
+
+    u8 data[0];
+};
+
+struct Arena *ArenaCreate(u32 size)
+{
+    struct Arena *arena;
+
+    // Alignment
+    if (size & 3)
+        size = 4 * ((size / 4) + 1);
+
+    arena = Alloc(sizeof(struct Arena) + size);
+
+    if (arena != NULL) {
+        arena->size = size;
+        arena->used = 0;
+        arena->highWaterMark = 0;
+    }
+
+    return arena;
+}
+
+void *ArenaAlloc(struct Arena *arena, u32 size)
+{
+    void *mem;
+
+    if (arena == NULL)
+        return NULL;
+
+    // Alignment
+    if (size & 3)
+        size = 4 * ((size / 4) + 1);
+
+    if (size > arena->size - arena->used)
+        return NULL;
+
+    mem = arena->data + arena->used;
+    arena->used += size;
+
+    if (arena->used > arena->highWaterMark)
+        arena->highWaterMark = arena->used;
+
+    return mem;
+}
+
+void *ArenaAllocZeroed(struct Arena *arena, u32 size)
+{
+    void *mem = ArenaAlloc(arena, size);
+
+    if (mem != NULL) {
+        if (size & 3)
+            size = 4 * ((size / 4) + 1);
+
+        CpuFill32(0, mem, size);
+    }
+
+    return mem;
+}
+
+void ArenaReset(struct Arena *arena)
+{
+    if (arena != NULL)
+        arena->used = 0;
+}
+
+void ArenaDestroy(struct Arena *arena)
+{
+    if (arena != NULL) {
+        AGBPrintf("Arena %x: peak use %d of %d bytes\n", (u32)arena, arena->highWaterMark, arena->size);
+        Free(arena);
+    }
+}
+
+u32 ArenaGetHighWaterMark(struct Arena *arena)
+{
+    if (arena == NULL)
+        return 0;
+
+    return arena->highWaterMark;
+}
+#endif // HEAP_ARENAS
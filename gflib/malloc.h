@@ -19,4 +19,18 @@ void *AllocZeroed(u32 size);
 void Free(void *pointer);
 void InitHeap(void *pointer, u32 size);
 
+#ifdef HEAP_ARENAS
+// An arena hands out memory from a single heap block and frees all of it at
+// once. It's meant for screens that allocate their buffers on entry and free
+// them on exit.
+struct Arena;
+
+struct Arena *ArenaCreate(u32 size);
+void *ArenaAlloc(struct Arena *arena, u32 size);
+void *ArenaAllocZeroed(struct Arena *arena, u32 size);
+void ArenaReset(struct Arena *arena);
+void ArenaDestroy(struct Arena *arena);
+u32 ArenaGetHighWaterMark(struct Arena *arena);
+#endif // HEAP_ARENAS
+
 #endif // GUARD_ALLOC_H
@@ -298,7 +298,11 @@ u32 gOamMatrixAllocBitmap;
 u8 gReservedSpritePaletteCount;
 
 EWRAM_DATA struct Sprite gSprites[MAX_SPRITES + 1] = {0};
+#ifdef FAST_SPRITE_SORT
+EWRAM_DATA static u32 sSpriteSortKeys[MAX_SPRITES] = {0};
+#else
 EWRAM_DATA static u16 sSpritePriorities[MAX_SPRITES] = {0};
+#endif
 EWRAM_DATA static u8 sSpriteOrder[MAX_SPRITES] = {0};
 EWRAM_DATA static bool8 sShouldProcessSpriteCopyRequests = 0;
 EWRAM_DATA static u8 sSpriteCopyRequestCount = 0;
@@ -378,6 +382,98 @@ void UpdateOamCoords(void)
     }
 }
 
+#ifdef FAST_SPRITE_SORT
+// Sprites are sorted by priority, then from the bottom of the screen up.
+// Each sprite's Y coordinate is wrapped once here instead of every time the
+// sort compares it.
+void BuildSpritePriorities(void)
+{
+    u32 i;
+    for (i = 0; i < MAX_SPRITES; i++)
+    {
+        struct Sprite *sprite = &gSprites[i];
+        u32 priority = sprite->subpriority | (sprite->oam.priority << 8);
+        s32 y = sprite->oam.y;
+
+        if (y >= DISPLAY_HEIGHT)
+            y = y - 256;
+
+        if (sprite->oam.affineMode == ST_OAM_AFFINE_DOUBLE
+         && sprite->oam.size == ST_OAM_SIZE_3)
+        {
+            u32 shape = sprite->oam.shape;
+            if (shape == ST_OAM_SQUARE || shape == ST_OAM_V_RECTANGLE)
+            {
+                if (y > 128)
+                    y = y - 256;
+            }
+        }
+
+        // y is between -127 and DISPLAY_HEIGHT - 1, and lower sprites go first.
+        sSpriteSortKeys[i] = (priority << 9) | (DISPLAY_HEIGHT - 1 - y);
+    }
+}
+
+// A stable merge sort, so sprites with equal keys stay in the order they
+// were in last frame, just like with the insertion sort below.
+void SortSprites(void)
+{
+    u8 buffer[MAX_SPRITES];
+    u8 *src = sSpriteOrder;
+    u8 *dest = buffer;
+    u32 width;
+    u32 i;
+
+    // The order rarely changes from one frame to the next.
+    for (i = 1; i < MAX_SPRITES; i++)
+    {
+        if (sSpriteSortKeys[sSpriteOrder[i - 1]] > sSpriteSortKeys[sSpriteOrder[i]])
+            break;
+    }
+
+    if (i == MAX_SPRITES)
+        return;
+
+    for (width = 1; width < MAX_SPRITES; width *= 2)
+    {
+        u8 *temp;
+        u32 start;
+
+        for (start = 0; start < MAX_SPRITES; start += width * 2)
+        {
+            u32 mid = min(start + width, MAX_SPRITES);
+            u32 end = min(start + width * 2, MAX_SPRITES);
+            u32 left = start;
+            u32 right = mid;
+            u32 k = start;
+
+            while (left < mid && right < end)
+            {
+                if (sSpriteSortKeys[src[right]] < sSpriteSortKeys[src[left]])
+                    dest[k++] = src[right++];
+                else
+                    dest[k++] = src[left++];
+            }
+
+            while (left < mid)
+                dest[k++] = src[left++];
+
+            while (right < end)
+                dest[k++] = src[right++];
+        }
+
+        temp = src;
+        src = dest;
+        dest = temp;
+    }
+
+    if (src != sSpriteOrder)
+    {
+        for (i = 0; i < MAX_SPRITES; i++)
+            sSpriteOrder[i] = src[i];
+    }
+}
+#else
 void BuildSpritePriorities(void)
 {
     u16 i;
@@ -481,6 +577,7 @@ void SortSprites(void)
         }
     }
 }
+#endif // FAST_SPRITE_SORT
 
 void CopyMatricesToOamBuffer(void)
 {
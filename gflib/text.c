@@ -25,6 +25,26 @@ u8 gUnknown_03002F84;
 struct Struct_03002F90 gUnknown_03002F90;
 TextFlags gTextFlags;
 
+#ifdef FAST_TEXT
+// A 2-way set associative cache of expanded glyphs. A glyph's expanded
+// pixels depend on the text colors as well as the glyph itself, so those
+// are part of the key.
+#define GLYPH_CACHE_SETS 16
+#define GLYPH_CACHE_WAYS 2
+
+#define GLYPH_CACHE_VALID 0x80000000
+
+struct CachedGlyph
+{
+    u32 key;
+    u32 colors;
+    struct Struct_03002F90 glyph;
+};
+
+EWRAM_DATA static struct CachedGlyph sGlyphCache[GLYPH_CACHE_SETS][GLYPH_CACHE_WAYS] = {0};
+EWRAM_DATA static u8 sGlyphCacheOldestWay[GLYPH_CACHE_SETS] = {0};
+#endif // FAST_TEXT
+
 const u8 gFontHalfRowOffsets[] =
 {
     0x00, 0x01, 0x02, 0x00, 0x03, 0x04, 0x05, 0x03, 0x06, 0x07, 0x08, 0x06, 0x00, 0x01, 0x02, 0x00,
@@ -462,6 +482,78 @@ u8 GetLastTextColor(u8 colorType)
     }
 }
 
+#ifdef FAST_TEXT
+
+// Copies one 8 pixel wide column of a glyph to the window. A glyph row is a
+// single word of 4bpp pixels and lands in at most two window tiles, so it's
+// written a word at a time, leaving the pixels under transparent ones alone.
+static void CopyGlyphColumnToWindow(u8 *windowTiles, u32 widthOffset, u32 x, u32 y, u32 width, u32 height, const u32 *src)
+{
+    u32 i, pixels, mask;
+    u32 *dst;
+    u32 shift = (x & 7) * 4;
+    u32 widthMask = (width >= 8) ? 0xFFFFFFFF : (1 << (width * 4)) - 1;
+
+    windowTiles += (x / 8) * 32;
+    for (i = y; i < y + height; i++)
+    {
+        pixels = *(src++);
+        mask = pixels | (pixels >> 1) | (pixels >> 2) | (pixels >> 3);
+        mask = ((mask & 0x11111111) * 0xF) & widthMask;
+        if (mask == 0)
+            continue;
+
+        pixels &= mask;
+        dst = (u32 *)(windowTiles + (i / 8) * widthOffset + (i & 7) * 4);
+        *dst = (*dst & ~(mask << shift)) | (pixels << shift);
+        if (shift != 0 && (mask >> (32 - shift)) != 0)
+        {
+            dst += 8;
+            *dst = (*dst & ~(mask >> (32 - shift))) | (pixels >> (32 - shift));
+        }
+    }
+}
+
+void CopyGlyphToWindow(struct TextPrinter *textPrinter)
+{
+    struct Window *win;
+    struct WindowTemplate *winTempl;
+    s32 width, height;
+    u32 currX, currY, widthOffset, topHeight, leftWidth;
+    u8 *windowTiles;
+
+    win = &gWindows[textPrinter->printerTemplate.windowId];
+    winTempl = &win->window;
+
+    width = (winTempl->width * 8) - textPrinter->printerTemplate.currentX;
+    if (width > gUnknown_03002F90.unk80)
+        width = gUnknown_03002F90.unk80;
+
+    height = (winTempl->height * 8) - textPrinter->printerTemplate.currentY;
+    if (height > gUnknown_03002F90.unk81)
+        height = gUnknown_03002F90.unk81;
+
+    if (width <= 0 || height <= 0)
+        return;
+
+    currX = textPrinter->printerTemplate.currentX;
+    currY = textPrinter->printerTemplate.currentY;
+    windowTiles = win->tileData;
+    widthOffset = winTempl->width * 32;
+    leftWidth = (width > 8) ? 8 : width;
+    topHeight = (height > 8) ? 8 : height;
+
+    CopyGlyphColumnToWindow(windowTiles, widthOffset, currX, currY, leftWidth, topHeight, gUnknown_03002F90.unk0);
+    if (width > 8)
+        CopyGlyphColumnToWindow(windowTiles, widthOffset, currX + 8, currY, width - 8, topHeight, gUnknown_03002F90.unk20);
+    if (height > 8)
+    {
+        CopyGlyphColumnToWindow(windowTiles, widthOffset, currX, currY + 8, leftWidth, height - 8, gUnknown_03002F90.unk40);
+        if (width > 8)
+            CopyGlyphColumnToWindow(windowTiles, widthOffset, currX + 8, currY + 8, width - 8, height - 8, gUnknown_03002F90.unk60);
+    }
+}
+#else
 #ifdef NONMATCHING
 
 #define GLYPH_COPY(fromY_, toY_, fromX_, toX_, unk)                                                                 \
@@ -1267,6 +1359,7 @@ _080052AA:\n\
     .pool");
 }
 #endif // NONMATCHING
+#endif // FAST_TEXT
 
 void ClearTextSpan(struct TextPrinter *textPrinter, u32 width)
 {
@@ -1563,6 +1656,67 @@ void DrawDownArrow(u8 windowId, u16 x, u16 y, u8 bgColor, bool8 drawArrow, u8 *c
     }
 }
 
+#ifdef FAST_TEXT
+// Expands a glyph into gUnknown_03002F90, reusing an earlier expansion of it
+// in the current text colors if there is one.
+static void DecompressGlyphCached(u8 glyphId, u16 currChar, bool32 isJapanese)
+{
+    struct CachedGlyph *entry;
+    u32 key, colors, set, way;
+
+    // Fonts 2 through 5 share glyphs.
+    if (glyphId >= 2 && glyphId <= 5)
+        glyphId = 2;
+    else if (glyphId != 0 && glyphId != 1 && glyphId != 7 && glyphId != 8)
+        return;
+
+    key = GLYPH_CACHE_VALID | (isJapanese ? 0x10000 : 0) | (glyphId << 12) | currChar;
+    colors = (gLastTextFgColor << 16) | (gLastTextBgColor << 8) | gLastTextShadowColor;
+    set = (currChar ^ (currChar >> 4) ^ glyphId) % GLYPH_CACHE_SETS;
+
+    for (way = 0; way < GLYPH_CACHE_WAYS; way++)
+    {
+        entry = &sGlyphCache[set][way];
+        if (entry->key == key && entry->colors == colors)
+        {
+            CpuFastCopy(entry->glyph.unk0, gUnknown_03002F90.unk0, 0x80);
+            gUnknown_03002F90.unk80 = entry->glyph.unk80;
+            gUnknown_03002F90.unk81 = entry->glyph.unk81;
+            sGlyphCacheOldestWay[set] = way ^ 1;
+            return;
+        }
+    }
+
+    switch (glyphId)
+    {
+    case 0:
+        DecompressGlyphFont0(currChar, isJapanese);
+        break;
+    case 1:
+        DecompressGlyphFont1(currChar, isJapanese);
+        break;
+    case 2:
+        DecompressGlyphFont2(currChar, isJapanese);
+        break;
+    case 7:
+        DecompressGlyphFont7(currChar, isJapanese);
+        break;
+    case 8:
+        DecompressGlyphFont8(currChar, isJapanese);
+        break;
+    }
+
+    way = sGlyphCacheOldestWay[set];
+    entry = &sGlyphCache[set][way];
+    entry->key = key;
+    entry->colors = colors;
+    CpuFastCopy(gUnknown_03002F90.unk0, entry->glyph.unk0, 0x80);
+    entry->glyph.unk80 = gUnknown_03002F90.unk80;
+    entry->glyph.unk81 = gUnknown_03002F90.unk81;
+    sGlyphCacheOldestWay[set] = way ^ 1;
+}
+#endif // FAST_TEXT
+
 u16 RenderText(struct TextPrinter *textPrinter)
 {
     struct TextPrinterSubStruct *subStruct = (struct TextPrinterSubStruct *)(&textPrinter->subStructFields);
@@ -1752,6 +1906,9 @@ u16 RenderText(struct TextPrinter *textPrinter)
             return 1;
         }
 
+#ifdef FAST_TEXT
+        DecompressGlyphCached(subStruct->glyphId, currChar, textPrinter->japanese);
+#else
         switch (subStruct->glyphId)
         {
         case 0:
@@ -1775,6 +1932,7 @@ u16 RenderText(struct TextPrinter *textPrinter)
         case 6:
             break;
         }
+#endif // FAST_TEXT
 
         CopyGlyphToWindow(textPrinter);
 
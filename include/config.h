@@ -34,4 +34,24 @@
 #endif
 #endif
 
+// Faster versions of some engine routines that don't produce a matching ROM.
+// These are only used with a modern compiler.
+#if MODERN
+#ifndef FAST_SPRITE_SORT
+#define FAST_SPRITE_SORT
+#endif
+#ifndef FAST_MALLOC
+#define FAST_MALLOC
+#endif
+#ifndef HEAP_ARENAS
+#define HEAP_ARENAS
+#endif
+#ifndef FAST_DMA3
+#define FAST_DMA3
+#endif
+#ifndef FAST_TEXT
+#define FAST_TEXT
+#endif
+#endif
+
 #endif // GUARD_CONFIG_H
@@ -13,19 +13,21 @@ $(DATA_ASM_BUILDDIR)/maps.o: $(DATA_ASM_SUBDIR)/maps.s $(LAYOUTS_DIR)/layouts.in
 $(DATA_ASM_BUILDDIR)/map_events.o: $(DATA_ASM_SUBDIR)/map_events.s $(MAPS_DIR)/events.inc $(MAP_EVENTS)
 	$(PREPROC) $< charmap.txt | $(CPP) -I include | $(AS) $(ASFLAGS) -o $@
 
-$(MAPS_DIR)/%/header.inc: $(MAPS_DIR)/%/map.json
-	$(MAPJSON) map emerald $< $(LAYOUTS_DIR)/layouts.json
-$(MAPS_DIR)/%/events.inc: $(MAPS_DIR)/%/header.inc ;
-$(MAPS_DIR)/%/connections.inc: $(MAPS_DIR)/%/events.inc ;
+# All map data is generated by a single mapjson run, which leaves files whose
+# contents didn't change untouched so that their dependents aren't rebuilt.
+# Since the outputs hang off a stamp, the stamp is forced out of date when any
+# of them has gone missing (after a mostlyclean, say).
+MAPJSON_STAMP := $(OBJ_DIR)/mapjson.stamp
+MAPJSON_OUTPUTS := $(MAP_HEADERS) $(MAP_EVENTS) $(MAP_CONNECTIONS) \
+	$(MAPS_DIR)/groups.inc $(MAPS_DIR)/connections.inc $(MAPS_DIR)/events.inc $(MAPS_DIR)/headers.inc \
+	$(LAYOUTS_DIR)/layouts.inc $(LAYOUTS_DIR)/layouts_table.inc \
+	include/constants/map_groups.h include/constants/layouts.h
 
-$(MAPS_DIR)/groups.inc: $(MAPS_DIR)/map_groups.json
-	$(MAPJSON) groups emerald $<
-$(MAPS_DIR)/connections.inc: $(MAPS_DIR)/groups.inc ;
-$(MAPS_DIR)/events.inc: $(MAPS_DIR)/connections.inc ;
-$(MAPS_DIR)/headers.inc: $(MAPS_DIR)/events.inc ;
-include/constants/map_groups.h: $(MAPS_DIR)/headers.inc ;
+$(MAPJSON_STAMP): $(MAPS_DIR)/map_groups.json $(LAYOUTS_DIR)/layouts.json $(MAP_DIRS:%=%map.json) $(if $(filter-out $(wildcard $(MAPJSON_OUTPUTS)),$(MAPJSON_OUTPUTS)),FORCE)
+	$(MAPJSON) all emerald $(MAPS_DIR)/map_groups.json $(LAYOUTS_DIR)/layouts.json
+	@touch $@
 
-$(LAYOUTS_DIR)/layouts.inc: $(LAYOUTS_DIR)/layouts.json
-	$(MAPJSON) layouts emerald $<
-$(LAYOUTS_DIR)/layouts_table.inc: $(LAYOUTS_DIR)/layouts.inc ;
-include/constants/layouts.h: $(LAYOUTS_DIR)/layouts_table.inc ;
+$(MAPJSON_OUTPUTS): $(MAPJSON_STAMP) ;
+
+.PHONY: FORCE
+FORCE:
@@ -213,6 +213,9 @@ static void sub_819F600(struct Sprite *sprite);
 static void Swap_ActionMon(u8 taskId);
 static void Swap_ActionCancel(u8 taskId);
 static void Swap_ActionPkmnForSwap(u8 taskId);
+#ifdef HEAP_ARENAS
+static void DestroyFactoryBuffers(void);
+#endif
 
 // Ewram variables
 static EWRAM_DATA u8 *sSelectMenuTilesetBuffer = NULL;
@@ -224,6 +227,10 @@ static EWRAM_DATA u8 *sSwapMenuTilesetBuffer = NULL;
 static EWRAM_DATA u8 *sSwapMonCardBgTilesetBuffer = NULL;
 static EWRAM_DATA u8 *sSwapMenuTilemapBuffer = NULL;
 static EWRAM_DATA u8 *sSwapMonCardBgTilemapBuffer = NULL;
+#ifdef HEAP_ARENAS
+// Holds the select or swap screen's tileset and tilemap buffers.
+static EWRAM_DATA struct Arena *sFactoryBuffersArena = NULL;
+#endif
 
 // IWRAM bss
 static struct FactorySelectMonsStruct *sFactorySelectScreen;
@@ -1109,10 +1116,18 @@ static void CB2_InitSelectScreen(void)
         gMain.state++;
         break;
     case 1:
+#ifdef HEAP_ARENAS
+        sFactoryBuffersArena = ArenaCreate(0x440 * 2 + 0x800 * 2);
+        sSelectMenuTilesetBuffer = ArenaAlloc(sFactoryBuffersArena, 0x440);
+        sSelectMonCardBgTilesetBuffer = ArenaAllocZeroed(sFactoryBuffersArena, 0x440);
+        sSelectMenuTilemapBuffer = ArenaAlloc(sFactoryBuffersArena, 0x800);
+        sSelectMonCardBgTilemapBuffer = ArenaAllocZeroed(sFactoryBuffersArena, 0x800);
+#else
         sSelectMenuTilesetBuffer = Alloc(0x440);
         sSelectMonCardBgTilesetBuffer = AllocZeroed(0x440);
         sSelectMenuTilemapBuffer = Alloc(0x800);
         sSelectMonCardBgTilemapBuffer = AllocZeroed(0x800);
+#endif
         ChangeBgX(0, 0, 0);
         ChangeBgY(0, 0, 0);
         ChangeBgX(1, 0, 0);
@@ -1395,6 +1410,23 @@ static void Select_SetBallSpritePaletteNum(u8 id)
     gSprites[sFactorySelectScreen->mons[id].spriteId].oam.paletteNum = palNum;
 }
 
+#ifdef HEAP_ARENAS
+// Destroys the buffers' arena and clears every pointer into it.
+static void DestroyFactoryBuffers(void)
+{
+    ArenaDestroy(sFactoryBuffersArena);
+    sFactoryBuffersArena = NULL;
+    sSelectMenuTilesetBuffer = NULL;
+    sSelectMonCardBgTilesetBuffer = NULL;
+    sSelectMenuTilemapBuffer = NULL;
+    sSelectMonCardBgTilemapBuffer = NULL;
+    sSwapMenuTilesetBuffer = NULL;
+    sSwapMonCardBgTilesetBuffer = NULL;
+    sSwapMenuTilemapBuffer = NULL;
+    sSwapMonCardBgTilemapBuffer = NULL;
+}
+#endif
+
 static void Task_FromSelectScreenToSummaryScreen(u8 taskId)
 {
     u8 i;
@@ -1413,10 +1445,14 @@ static void Task_FromSelectScreenToSummaryScreen(u8 taskId)
             DestroyTask(sFactorySelectScreen->fadeSpeciesNameTaskId);
             sub_819F444(sFactorySelectScreen->unk294[1], &sFactorySelectScreen->unk2A0);
             Select_DestroyAllSprites();
+#ifdef HEAP_ARENAS
+            DestroyFactoryBuffers();
+#else
             FREE_AND_SET_NULL(sSelectMenuTilesetBuffer);
             FREE_AND_SET_NULL(sSelectMonCardBgTilesetBuffer);
             FREE_AND_SET_NULL(sSelectMenuTilemapBuffer);
             FREE_AND_SET_NULL(sSelectMonCardBgTilemapBuffer);
+#endif
             FreeAllWindowBuffers();
             gTasks[taskId].data[0] = 8;
         }
@@ -1450,9 +1486,14 @@ static void Task_CloseSelectionScreen(u8 taskId)
                 Select_CopyMonsToPlayerParty();
                 DestroyTask(sFactorySelectScreen->fadeSpeciesNameTaskId);
                 Select_DestroyAllSprites();
+#ifdef HEAP_ARENAS
+                DestroyFactoryBuffers();
+#else
+                // BUG: sSelectMonCardBgTilesetBuffer is never freed.
                 FREE_AND_SET_NULL(sSelectMenuTilesetBuffer);
                 FREE_AND_SET_NULL(sSelectMenuTilemapBuffer);
                 FREE_AND_SET_NULL(sSelectMonCardBgTilemapBuffer);
+#endif
                 FREE_AND_SET_NULL(sFactorySelectScreen);
                 FreeAllWindowBuffers();
                 SetMainCallback2(CB2_ReturnToFieldContinueScript);
@@ -2282,10 +2323,14 @@ static void Task_FromSwapScreenToSummaryScreen(u8 taskId)
             DestroyTask(sFactorySwapScreen->fadeSpeciesNameTaskId);
             sub_819F444(sFactorySwapScreen->unk2C, &sFactorySwapScreen->unk30);
             Swap_DestroyAllSprites();
+#ifdef HEAP_ARENAS
+            DestroyFactoryBuffers();
+#else
             FREE_AND_SET_NULL(sSwapMenuTilesetBuffer);
             FREE_AND_SET_NULL(sSwapMonCardBgTilesetBuffer);
             FREE_AND_SET_NULL(sSwapMenuTilemapBuffer);
             FREE_AND_SET_NULL(sSwapMonCardBgTilemapBuffer);
+#endif
             FreeAllWindowBuffers();
             gTasks[taskId].data[0] = 8;
         }
@@ -2334,10 +2379,14 @@ static void Task_CloseSwapScreen(u8 taskId)
             {
                 DestroyTask(sFactorySwapScreen->fadeSpeciesNameTaskId);
                 Swap_DestroyAllSprites();
+#ifdef HEAP_ARENAS
+                DestroyFactoryBuffers();
+#else
                 FREE_AND_SET_NULL(sSwapMenuTilesetBuffer);
                 FREE_AND_SET_NULL(sSwapMonCardBgTilesetBuffer);
                 FREE_AND_SET_NULL(sSwapMenuTilemapBuffer);
                 FREE_AND_SET_NULL(sSwapMonCardBgTilemapBuffer);
+#endif
                 FREE_AND_SET_NULL(sFactorySwapScreen);
                 FreeAllWindowBuffers();
                 SetMainCallback2(CB2_ReturnToFieldContinueScript);
@@ -3116,10 +3165,18 @@ static void CB2_InitSwapScreen(void)
         gMain.state++;
         break;
     case 1:
+#ifdef HEAP_ARENAS
+        sFactoryBuffersArena = ArenaCreate(0x440 * 2 + 0x800 * 2);
+        sSwapMenuTilesetBuffer = ArenaAlloc(sFactoryBuffersArena, 0x440);
+        sSwapMonCardBgTilesetBuffer = ArenaAllocZeroed(sFactoryBuffersArena, 0x440);
+        sSwapMenuTilemapBuffer = ArenaAlloc(sFactoryBuffersArena, 0x800);
+        sSwapMonCardBgTilemapBuffer = ArenaAllocZeroed(sFactoryBuffersArena, 0x800);
+#else
         sSwapMenuTilesetBuffer = Alloc(0x440);
         sSwapMonCardBgTilesetBuffer = AllocZeroed(0x440);
         sSwapMenuTilemapBuffer = Alloc(0x800);
         sSwapMonCardBgTilemapBuffer = AllocZeroed(0x800);
+#endif
         ChangeBgX(0, 0, 0);
         ChangeBgY(0, 0, 0);
         ChangeBgX(1, 0, 0);
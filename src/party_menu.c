@@ -145,6 +145,9 @@ EWRAM_DATA struct PartyMenu gPartyMenu = {0};
 static EWRAM_DATA struct PartyMenuBox *sPartyMenuBoxes = NULL;
 static EWRAM_DATA u8 *sPartyBgGfxTilemap = NULL;
 static EWRAM_DATA u8 *sPartyBgTilemapBuffer = NULL;
+#ifdef HEAP_ARENAS
+static EWRAM_DATA struct Arena *sPartyMenuArena = NULL;
+#endif
 EWRAM_DATA bool8 gPartyMenuUseExitCallback = 0;
 EWRAM_DATA u8 gSelectedMonPartyId = 0;
 EWRAM_DATA MainCallback gPostMenuFieldCallback = NULL;
@@ -416,7 +419,12 @@ static void InitPartyMenu(u8 menuType, u8 layout, u8 partyAction, bool8 keepCurs
     u16 i;
 
     ResetPartyMenu();
+#ifdef HEAP_ARENAS
+    sPartyMenuArena = ArenaCreate(sizeof(struct PartyMenuInternal) + 0x800 + sizeof(struct PartyMenuBox[PARTY_SIZE]));
+    sPartyMenuInternal = ArenaAlloc(sPartyMenuArena, sizeof(struct PartyMenuInternal));
+#else
     sPartyMenuInternal = Alloc(sizeof(struct PartyMenuInternal));
+#endif
     if (sPartyMenuInternal == NULL)
     {
         SetMainCallback2(callback);
@@ -634,7 +642,11 @@ static void ResetPartyMenu(void)
 
 static bool8 AllocPartyMenuBg(void)
 {
+#ifdef HEAP_ARENAS
+    sPartyBgTilemapBuffer = ArenaAlloc(sPartyMenuArena, 0x800);
+#else
     sPartyBgTilemapBuffer = Alloc(0x800);
+#endif
     if (sPartyBgTilemapBuffer == NULL)
         return FALSE;
 
@@ -710,6 +722,12 @@ static void PartyPaletteBufferCopy(u8 offset)
 
 static void FreePartyPointers(void)
 {
+#ifdef HEAP_ARENAS
+    ArenaDestroy(sPartyMenuArena);
+    sPartyMenuArena = NULL;
+    if (sPartyBgGfxTilemap)
+        Free(sPartyBgGfxTilemap);
+#else
     if (sPartyMenuInternal)
         Free(sPartyMenuInternal);
     if (sPartyBgTilemapBuffer)
@@ -718,6 +736,7 @@ static void FreePartyPointers(void)
         Free(sPartyBgGfxTilemap);
     if (sPartyMenuBoxes)
         Free(sPartyMenuBoxes);
+#endif
     FreeAllWindowBuffers();
 }
 
@@ -725,7 +744,11 @@ static void InitPartyMenuBoxes(u8 layout)
 {
     u8 i;
 
+#ifdef HEAP_ARENAS
+    sPartyMenuBoxes = ArenaAlloc(sPartyMenuArena, sizeof(struct PartyMenuBox[PARTY_SIZE]));
+#else
     sPartyMenuBoxes = Alloc(sizeof(struct PartyMenuBox[PARTY_SIZE]));
+#endif
 
     for (i = 0; i < PARTY_SIZE; i++)
     {
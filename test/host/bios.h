@@ -0,0 +1,29 @@
+// Host versions of the BIOS calls the checked code makes. Include this after
+// the gflib source.
+
+#ifndef GUARD_TEST_HOST_BIOS_H
+#define GUARD_TEST_HOST_BIOS_H
+
+void CpuSet(const void *src, void *dest, u32 control)
+{
+    u32 count = control & 0x1FFFFF;
+    u32 i;
+
+    if (control & CPU_SET_32BIT)
+    {
+        for (i = 0; i < count; i++)
+            ((u32 *)dest)[i] = ((const u32 *)src)[(control & CPU_SET_SRC_FIXED) ? 0 : i];
+    }
+    else
+    {
+        for (i = 0; i < count; i++)
+            ((u16 *)dest)[i] = ((const u16 *)src)[(control & CPU_SET_SRC_FIXED) ? 0 : i];
+    }
+}
+
+void CpuFastSet(const void *src, void *dest, u32 control)
+{
+    CpuSet(src, dest, CPU_SET_32BIT | (control & (CPU_FAST_SET_SRC_FIXED | 0x1FFFFF)));
+}
+
+#endif // GUARD_TEST_HOST_BIOS_H
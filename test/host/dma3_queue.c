@@ -0,0 +1,203 @@
+// Queues random copies and fills to palette RAM and VRAM through the DMA3
+// manager, then runs its VBlank processing until the queue drains. After every
+// round, palette RAM and VRAM must hold what applying each accepted request
+// right away would have left there. A quarter of the copies read from palette
+// RAM or VRAM, so the order of dependent requests matters.
+//
+// The manager is built against dma3_stub/global.h, and palette RAM, VRAM and
+// a stretch of EWRAM are mapped at their GBA addresses.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include "global.h"
+#include "dma3_manager.c"
+
+#define NUM_ROUNDS 20000
+#define MAX_FRAMES_PER_ROUND 100
+
+#define EWRAM_START 0x2000000
+#define EWRAM_SIZE 0x40000
+
+// Palette RAM through the end of VRAM, with the IO in between.
+#define VIDEO_START PLTT
+#define VIDEO_SIZE (VRAM + VRAM_SIZE - PLTT)
+
+u8 gFakeVcount;
+static u8 sExpected[VIDEO_SIZE];
+
+static u8 *Expected(u32 address)
+{
+    if (address >= VIDEO_START && address < VIDEO_START + VIDEO_SIZE)
+        return &sExpected[address - VIDEO_START];
+    return (u8 *)(uintptr_t)address;
+}
+
+// Picks a 32-byte aligned range in palette RAM or VRAM. Ranges in palette RAM
+// are cut down to fit.
+static u32 RandomVideoRange(u16 *size)
+{
+    int region = rand() % 4;
+    u32 address;
+
+    if (region == 0 && *size <= PLTT_SIZE)
+    {
+        if (*size > 8 * 32)
+            *size = (1 + rand() % 8) * 32;
+        return PLTT + (rand() % ((PLTT_SIZE - *size) / 32 + 1)) * 32;
+    }
+
+    // BG tiles, BG tilemaps or OBJ tiles.
+    address = VRAM + (region == 2 ? 0x10000 : region == 3 ? 0x8000 : 0) + (rand() % 0x380) * 32;
+
+    if (address + *size > VRAM + VRAM_SIZE)
+        address = VRAM + VRAM_SIZE - *size;
+
+    return address;
+}
+
+static bool32 Overlaps(u32 a, u32 b, u16 size)
+{
+    return a < b + size && b < a + size;
+}
+
+static void QueueRandomRequest(void)
+{
+    int kind = rand() % 4;
+    u16 size = (rand() % 10 == 0) ? 0x800 : (1 + rand() % 64) * 32;
+    u32 dest = RandomVideoRange(&size);
+    u32 src;
+    u32 value;
+    u32 i;
+
+    if (kind < 2)
+    {
+        if (rand() % 4 == 0)
+        {
+            u16 srcSize = size;
+            int tries = 0;
+
+            do
+            {
+                src = RandomVideoRange(&srcSize);
+            } while ((srcSize != size || Overlaps(src, dest, size)) && ++tries < 50);
+
+            if (tries == 50)
+                return;
+        }
+        else
+        {
+            src = EWRAM_START + (rand() % ((EWRAM_SIZE - size) / 32)) * 32;
+        }
+
+        if (RequestDma3Copy((void *)(uintptr_t)src, (void *)(uintptr_t)dest, size, kind) >= 0)
+            memcpy(Expected(dest), Expected(src), size);
+    }
+    else
+    {
+        value = rand();
+
+        if (RequestDma3Fill(value, (void *)(uintptr_t)dest, size, kind - 2) >= 0)
+        {
+            for (i = 0; i < size; i += (kind == 3) ? 4 : 2)
+            {
+                if (kind == 3)
+                    *(u32 *)Expected(dest + i) = value;
+                else
+                    *(u16 *)Expected(dest + i) = value;
+            }
+        }
+    }
+}
+
+static int Drain(void)
+{
+    int frames = 0;
+
+    do
+    {
+        ProcessDma3Requests();
+        frames++;
+    } while (CheckForSpaceForDma3Request(-1) == -1 && frames < MAX_FRAMES_PER_ROUND);
+
+    return frames;
+}
+
+#ifdef FAST_DMA3
+// A request that was superseded isn't finished until the request that
+// replaced it is, even when that one is superseded in turn.
+static void CheckSupersededRequests(void)
+{
+    s16 a, b, c, d;
+
+    ClearDma3Requests();
+    a = RequestDma3Fill(1, (void *)(VRAM + 0x100), 0x20, 1);
+    b = RequestDma3Fill(2, (void *)(VRAM + 0x100), 0x40, 1);
+    c = RequestDma3Fill(3, (void *)(VRAM + 0x120), 0x20, 1);
+    d = RequestDma3Fill(4, (void *)(VRAM + 0x0C0), 0x100, 1);
+
+    if (CheckForSpaceForDma3Request(a) != -1 || CheckForSpaceForDma3Request(b) != -1
+     || CheckForSpaceForDma3Request(c) != -1 || CheckForSpaceForDma3Request(d) != -1)
+    {
+        printf("superseded request reported finished early\n");
+        exit(1);
+    }
+
+    ProcessDma3Requests();
+
+    if (CheckForSpaceForDma3Request(-1) != 0)
+    {
+        printf("superseded request still pending after its replacement\n");
+        exit(1);
+    }
+
+    printf("superseded requests: ok\n");
+}
+#endif
+
+int main(void)
+{
+    u8 *video = mmap((void *)VIDEO_START, VIDEO_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+    u8 *ewram = mmap((void *)EWRAM_START, EWRAM_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+    long frames = 0;
+    int round;
+    int i;
+
+    if (video != (u8 *)VIDEO_START || ewram != (u8 *)EWRAM_START)
+    {
+        printf("couldn't map GBA memory\n");
+        return 1;
+    }
+
+    srand(11);
+
+    for (i = 0; i < EWRAM_SIZE; i++)
+        ewram[i] = rand();
+
+    ClearDma3Requests();
+
+    for (round = 0; round < NUM_ROUNDS; round++)
+    {
+        // The second half queues more than fits, so requests get dropped.
+        int numRequests = rand() % (round < NUM_ROUNDS / 2 ? 40 : 200);
+
+        for (i = 0; i < numRequests; i++)
+            QueueRandomRequest();
+
+        frames += Drain();
+
+        if (memcmp((void *)PLTT, Expected(PLTT), PLTT_SIZE) != 0
+         || memcmp((void *)VRAM, Expected(VRAM), VRAM_SIZE) != 0)
+        {
+            printf("round %d: video memory differs\n", round);
+            return 1;
+        }
+    }
+
+    printf("%d rounds: ok\n", NUM_ROUNDS);
+    fprintf(stderr, "dma3_queue: %ld frames to drain\n", frames);
+#ifdef FAST_DMA3
+    CheckSupersededRequests();
+#endif
+    return 0;
+}
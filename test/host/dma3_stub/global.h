@@ -0,0 +1,52 @@
+// Stands in for include/global.h when dma3_manager.c is built on the host.
+// The DMA macros copy and fill directly instead of programming channel 3.
+
+#ifndef GUARD_GLOBAL_H
+#define GUARD_GLOBAL_H
+
+#include <stdint.h>
+#include <string.h>
+#include "config.h"
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef u8 bool8;
+typedef u32 bool32;
+
+#define TRUE 1
+#define FALSE 0
+#define BSS_DATA
+
+#define PLTT 0x5000000
+#define PLTT_SIZE 0x400
+#define VRAM 0x6000000
+#define VRAM_SIZE 0x18000
+#define OBJ_VRAM0 (VRAM + 0x10000)
+
+// The harness decides when VBlank runs out.
+extern u8 gFakeVcount;
+#define REG_ADDR_VCOUNT (&gFakeVcount)
+
+#define DmaCopy16(ch, src, dest, size) memcpy((void *)(dest), (const void *)(src), (size))
+#define DmaCopy32(ch, src, dest, size) memcpy((void *)(dest), (const void *)(src), (size))
+
+#define DmaFill16(ch, value, dest, size)               \
+{                                                      \
+    u16 _value = (value);                              \
+    u32 _i;                                            \
+    for (_i = 0; _i < (size) / 2; _i++)                \
+        ((u16 *)(dest))[_i] = _value;                  \
+}
+
+#define DmaFill32(ch, value, dest, size)               \
+{                                                      \
+    u32 _value = (value);                              \
+    u32 _i;                                            \
+    for (_i = 0; _i < (size) / 4; _i++)                \
+        ((u32 *)(dest))[_i] = _value;                  \
+}
+
+#endif // GUARD_GLOBAL_H
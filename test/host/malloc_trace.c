@@ -0,0 +1,174 @@
+// Replays allocation traces through the heap in gflib/malloc.c. The first
+// replay of each trace runs CheckHeap after every operation and checks that
+// no block's contents were overwritten. The rest are timed.
+//
+// Usage: malloc_trace [-repeat N] TRACE...
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "malloc.c"
+#include "malloc.h"
+#include "bios.h"
+
+#define MAX_BLOCKS 1024
+#define MAX_OPS 100000
+
+struct TraceOp
+{
+    bool8 isAlloc;
+    u16 id;
+    u32 size;
+};
+
+static struct TraceOp sOps[MAX_OPS];
+static int sNumOps;
+static u32 sHeap[HEAP_SIZE / 4];
+static u8 *sBlocks[MAX_BLOCKS];
+static u32 sBlockSizes[MAX_BLOCKS];
+static u8 sBlockTags[MAX_BLOCKS];
+
+static void ReadTrace(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    char line[256];
+
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Can't open %s\n", path);
+        exit(1);
+    }
+
+    sNumOps = 0;
+
+    while (fgets(line, sizeof(line), fp) != NULL)
+    {
+        struct TraceOp *op = &sOps[sNumOps];
+        unsigned id, size = 0;
+
+        if (line[0] == '#' || line[0] == '\n')
+            continue;
+
+        if (sNumOps == MAX_OPS
+         || sscanf(line + 1, "%u %u", &id, &size) < 1
+         || (line[0] != 'a' && line[0] != 'f')
+         || id >= MAX_BLOCKS)
+        {
+            fprintf(stderr, "%s: bad line: %s", path, line);
+            exit(1);
+        }
+
+        op->isAlloc = (line[0] == 'a');
+        op->id = id;
+        op->size = size;
+        sNumOps++;
+    }
+
+    fclose(fp);
+}
+
+static void Fail(const char *path, int opIndex, const char *message)
+{
+    printf("%s: operation %d: %s\n", path, opIndex + 1, message);
+    exit(1);
+}
+
+// Returns how many allocations failed.
+static int Replay(const char *path, bool32 check)
+{
+    int numFailed = 0;
+    int i;
+    u32 j;
+
+    InitHeap(sHeap, sizeof(sHeap));
+
+    for (i = 0; i < sNumOps; i++)
+    {
+        struct TraceOp *op = &sOps[i];
+
+        if (op->isAlloc)
+        {
+            if (sBlocks[op->id] != NULL)
+                Fail(path, i, "block allocated twice");
+
+            sBlocks[op->id] = Alloc(op->size);
+            sBlockSizes[op->id] = op->size;
+            sBlockTags[op->id] = i;
+
+            if (sBlocks[op->id] == NULL)
+                numFailed++;
+            else if (check)
+                memset(sBlocks[op->id], sBlockTags[op->id], op->size);
+        }
+        else if (sBlocks[op->id] != NULL)
+        {
+            if (check)
+            {
+                for (j = 0; j < sBlockSizes[op->id]; j++)
+                {
+                    if (sBlocks[op->id][j] != sBlockTags[op->id])
+                        Fail(path, i, "block contents overwritten");
+                }
+            }
+
+            Free(sBlocks[op->id]);
+            sBlocks[op->id] = NULL;
+        }
+
+        if (check && !CheckHeap())
+            Fail(path, i, "CheckHeap failed");
+    }
+
+    for (i = 0; i < MAX_BLOCKS; i++)
+    {
+        if (sBlocks[i] != NULL)
+        {
+            Free(sBlocks[i]);
+            sBlocks[i] = NULL;
+        }
+    }
+
+    if (check && !CheckHeap())
+        Fail(path, sNumOps - 1, "CheckHeap failed after freeing everything");
+
+    return numFailed;
+}
+
+int main(int argc, char **argv)
+{
+    int repeat = 50;
+    int i;
+
+    for (i = 1; i < argc; i++)
+    {
+        struct timespec start, end;
+        int numAllocs = 0;
+        int numFailed;
+        int j;
+
+        if (strcmp(argv[i], "-repeat") == 0 && i + 1 < argc)
+        {
+            repeat = atoi(argv[++i]);
+            continue;
+        }
+
+        ReadTrace(argv[i]);
+
+        for (j = 0; j < sNumOps; j++)
+            numAllocs += sOps[j].isAlloc;
+
+        numFailed = Replay(argv[i], TRUE);
+        printf("%s: %d allocations, %d failed\n", argv[i], numAllocs, numFailed);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        for (j = 0; j < repeat; j++)
+            Replay(argv[i], FALSE);
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        fprintf(stderr, "%s: %d replays in %.1f ms\n", argv[i], repeat,
+                (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6);
+    }
+
+    return 0;
+}
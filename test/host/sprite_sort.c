@@ -0,0 +1,67 @@
+// Replays random sprite states through BuildSpritePriorities and SortSprites
+// and prints a running hash of sSpriteOrder. The order is kept from one frame
+// to the next, as in the game, so ties have to come out the same way too.
+
+#include <stdio.h>
+#include <time.h>
+#include "sprite.c"
+
+#define NUM_FRAMES 200000
+
+static u32 HashOrder(u32 hash)
+{
+    int i;
+
+    for (i = 0; i < MAX_SPRITES; i++)
+        hash = (hash ^ sSpriteOrder[i]) * 16777619;
+
+    return hash;
+}
+
+static void RandomizeSprite(struct Sprite *sprite, int maxSubpriority)
+{
+    sprite->oam.y = rand() % 256;
+    sprite->oam.priority = rand() % 4;
+    sprite->oam.affineMode = rand() % 4;
+    sprite->oam.size = rand() % 4;
+    sprite->oam.shape = rand() % 3;
+    sprite->subpriority = rand() % maxSubpriority;
+}
+
+int main(void)
+{
+    struct timespec start, end;
+    long long sortTime = 0;
+    u32 hash = 2166136261;
+    int frame;
+    int i;
+
+    srand(3);
+    ResetAllSprites();
+
+    for (frame = 0; frame < NUM_FRAMES; frame++)
+    {
+        // Every fourth frame reshuffles everything. The rest move a few
+        // sprites, which is what the game mostly does. Few subpriorities
+        // make for lots of ties.
+        for (i = 0; i < MAX_SPRITES; i++)
+        {
+            if (frame % 4 == 0 || rand() % 8 == 0)
+                RandomizeSprite(&gSprites[i], frame % 3 ? 4 : 256);
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        BuildSpritePriorities();
+        SortSprites();
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        sortTime += (end.tv_sec - start.tv_sec) * 1000000000LL + end.tv_nsec - start.tv_nsec;
+
+        hash = HashOrder(hash);
+
+        if ((frame + 1) % 10000 == 0)
+            printf("frame %d: %08x\n", frame + 1, hash);
+    }
+
+    fprintf(stderr, "sprite_sort: %lld ns per frame\n", sortTime / NUM_FRAMES);
+    return 0;
+}
@@ -0,0 +1,34 @@
+# The glyphs from data/fonts.s that gflib/text.c uses, for the host assembler.
+
+	.section .rodata
+
+	.macro font_data label, file
+	.balign 4
+	.global \label
+\label:
+	.incbin "\file"
+	.endm
+
+	.macro font_widths label, file
+	.balign 4
+	.global \label
+\label:
+	.include "\file"
+	.endm
+
+	font_data gFont8LatinGlyphs, "graphics/fonts/font8.latfont"
+	font_widths gFont8LatinGlyphWidths, "graphics/fonts/font8_latin_widths.inc"
+	font_data gFont0LatinGlyphs, "graphics/fonts/font0.latfont"
+	font_widths gFont0LatinGlyphWidths, "graphics/fonts/font0_latin_widths.inc"
+	font_data gFont7LatinGlyphs, "graphics/fonts/font7.latfont"
+	font_widths gFont7LatinGlyphWidths, "graphics/fonts/font7_latin_widths.inc"
+	font_data gFont2LatinGlyphs, "graphics/fonts/font2.latfont"
+	font_widths gFont2LatinGlyphWidths, "graphics/fonts/font2_latin_widths.inc"
+	font_data gFont1LatinGlyphs, "graphics/fonts/font1.latfont"
+	font_widths gFont1LatinGlyphWidths, "graphics/fonts/font1_latin_widths.inc"
+	font_data gFont0JapaneseGlyphs, "graphics/fonts/font0.hwjpnfont"
+	font_data gFont1JapaneseGlyphs, "graphics/fonts/font1.hwjpnfont"
+	font_data gFont2JapaneseGlyphs, "graphics/fonts/font2.fwjpnfont"
+	font_widths gFont2JapaneseGlyphWidths, "graphics/fonts/font2_japanese_widths.inc"
+
+	.section .note.GNU-stack, "", @progbits
@@ -0,0 +1,132 @@
+// Prints every string in src/strings.c with each font, into a message box
+// sized window and a small one that clips most of it, and prints a hash of
+// the window's pixels for each string. The window is hashed after every
+// frame of printing, so text that's later scrolled away or cleared counts
+// too. A is held down, so prompts go straight on. Then everything is printed
+// again without hashing, and that's timed.
+//
+// Unlike the other checks, this one goes through preproc like the game's C
+// files do, to get the encoded strings and the graphics behind INCBIN. The
+// glyphs come from text_fonts.s. The matching build uses the C version of
+// CopyGlyphToWindow (NONMATCHING) in place of the asm one.
+
+#include <stdio.h>
+#include <time.h>
+#include "text.c"
+#include "window.c"
+#include "blit.c"
+#include "unk_text_util_2.c"
+#include "strings.c"
+#include "bios.h"
+
+#define NUM_FONTS 9
+#define MAX_FRAMES 10000
+
+struct Main gMain;
+u32 gBattleTypeFlags;
+struct MusicPlayerInfo gMPlayInfo_BGM;
+static struct SaveBlock2 sSaveBlock2 = { .optionsTextSpeed = OPTIONS_TEXT_SPEED_FAST };
+struct SaveBlock2 *gSaveBlock2Ptr = &sSaveBlock2;
+
+static const u8 *const sStrings[] =
+{
+#define STRING(name) name,
+#include "text_strings.inc"
+#undef STRING
+};
+
+static const char *const sStringNames[] =
+{
+#define STRING(name) #name,
+#include "text_strings.inc"
+#undef STRING
+};
+
+static const struct WindowTemplate sWindowTemplates[] =
+{
+    { .bg = 0, .tilemapLeft = 2, .tilemapTop = 15, .width = 27, .height = 4, .paletteNum = 15, .baseBlock = 1 },
+    { .bg = 0, .tilemapLeft = 2, .tilemapTop = 2, .width = 7, .height = 2, .paletteNum = 15, .baseBlock = 0x100 },
+};
+
+static u8 sTileData[ARRAY_COUNT(sWindowTemplates)][27 * 4 * TILE_SIZE_4BPP];
+
+// The parts of the game that printing touches, but that don't affect the pixels.
+u16 LoadBgTiles(u8 bg, const void *src, u16 size, u16 destOffset) { return 0; }
+void CopyBgTilemapBufferToVram(u8 bg) {}
+void *GetBgTilemapBuffer(u8 bg) { return NULL; }
+u32 GetPlayerTextSpeed(void) { return gSaveBlock2Ptr->optionsTextSpeed; }
+void PlaySE(u16 songNum) {}
+void PlayBGM(u16 songNum) {}
+bool8 IsSEPlaying(void) { return FALSE; }
+void m4aMPlayStop(struct MusicPlayerInfo *mplayInfo) {}
+void m4aMPlayContinue(struct MusicPlayerInfo *mplayInfo) {}
+
+static u32 HashWindow(u32 hash, u8 windowId)
+{
+    const struct WindowTemplate *template = &gWindows[windowId].window;
+    u32 size = template->width * template->height * TILE_SIZE_4BPP;
+    u32 i;
+
+    for (i = 0; i < size; i++)
+        hash = (hash ^ gWindows[windowId].tileData[i]) * 16777619;
+
+    return hash;
+}
+
+// Hashes the window after every frame if hash isn't NULL.
+static void PrintString(u32 *hash, u8 windowId, u8 fontId, const u8 *str)
+{
+    int frames = 0;
+
+    FillWindowPixelBuffer(windowId, PIXEL_FILL(1));
+    AddTextPrinterParameterized(windowId, fontId, str, 0, 1, 1, NULL);
+
+    while (IsTextPrinterActive(windowId) && frames++ < MAX_FRAMES)
+    {
+        RunTextPrinters();
+        if (hash != NULL)
+            *hash = HashWindow(*hash, windowId);
+    }
+}
+
+static void PrintAllStrings(bool32 check)
+{
+    u32 i, windowId, fontId;
+
+    for (i = 0; i < ARRAY_COUNT(sStrings); i++)
+    {
+        u32 hash = 2166136261;
+
+        for (windowId = 0; windowId < ARRAY_COUNT(sWindowTemplates); windowId++)
+        {
+            for (fontId = 0; fontId < NUM_FONTS; fontId++)
+                PrintString(check ? &hash : NULL, windowId, fontId, sStrings[i]);
+        }
+
+        if (check)
+            printf("%08X %s\n", hash, sStringNames[i]);
+    }
+}
+
+int main(void)
+{
+    struct timespec start, end;
+    u32 i;
+
+    for (i = 0; i < ARRAY_COUNT(sWindowTemplates); i++)
+    {
+        gWindows[i].window = sWindowTemplates[i];
+        gWindows[i].tileData = sTileData[i];
+    }
+
+    SetDefaultFontsPointer();
+    gMain.newKeys = A_BUTTON;
+    PrintAllStrings(TRUE);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    PrintAllStrings(FALSE);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    fprintf(stderr, "text_render: %u strings in %.1f ms\n", (unsigned)ARRAY_COUNT(sStrings),
+            (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6);
+    return 0;
+}
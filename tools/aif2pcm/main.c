@@ -24,6 +24,13 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <limits.h>
+#include "toolcache.h"
+
+#ifndef _MSC_VER
+#include <dirent.h>
+#include <pthread.h>
+#include <unistd.h>
+#endif
 
 /* extended.c */
 void ieee754_write_extended (double, uint8_t*);
@@ -418,7 +425,7 @@ struct Bytes *delta_decompress(struct Bytes *delta, unsigned int expected_length
 	return pcm;
 }
 
-int get_delta_index(uint8_t sample, uint8_t prev_sample)
+int find_delta_index(uint8_t sample, uint8_t prev_sample)
 {
 	int best_error = INT_MAX;
 	int best_index = -1;
@@ -438,68 +445,168 @@ int get_delta_index(uint8_t sample, uint8_t prev_sample)
 	return best_index;
 }
 
-struct Bytes *delta_compress(struct Bytes *pcm)
+// Best delta index + 1 for each (prev_sample, sample) pair, or 0 if it hasn't been looked up yet.
+// Filling it lazily is cheaper than filling it up front for a single short sample.
+uint8_t gDeltaIndexTable[256][256];
+
+void fill_delta_index_table(void)
 {
-	struct Bytes *delta = malloc(sizeof(struct Bytes));
-	// estimate the length so we can malloc
-	int num_blocks = pcm->length / 64;
-	delta->length = num_blocks * 33;
+	for (int prev_sample = 0; prev_sample < 256; prev_sample++)
+	{
+		for (int sample = 0; sample < 256; sample++)
+		{
+			gDeltaIndexTable[prev_sample][sample] = find_delta_index(sample, prev_sample) + 1;
+		}
+	}
+}
+
+int get_delta_index(uint8_t sample, uint8_t prev_sample)
+{
+	uint8_t *entry = &gDeltaIndexTable[prev_sample][sample];
 
-	int extra = pcm->length % 64;
-	if (extra)
+	if (*entry == 0)
 	{
-		delta->length += 1;
-		extra -= 1;
+		*entry = find_delta_index(sample, prev_sample) + 1;
 	}
-	if (extra)
+
+	return *entry - 1;
+}
+
+// Picks each delta to get as close as possible to the next sample.
+void encode_block_greedy(const uint8_t *samples, int count, uint8_t *indices)
+{
+	uint8_t base = samples[0];
+
+	for (int i = 1; i < count; i++)
 	{
-		delta->length += 1;
-		extra -= 1;
+		int delta_index = get_delta_index(samples[i], base);
+		base += gDeltaEncodingTable[delta_index];
+		indices[i - 1] = delta_index;
 	}
-	if (extra)
+}
+
+// Picks the deltas that minimize the total squared error over the whole block, with a Viterbi search
+// over the 256 possible decoder states. Errors are measured on the signed sample values.
+void encode_block_trellis(const uint8_t *samples, int count, uint8_t *indices)
+{
+	uint32_t cost[256];
+	uint32_t new_cost[256];
+	uint8_t from_state[63][256];
+	uint8_t from_index[63][256];
+
+	// Samples that were decoded from compressed data in the first place come out exactly
+	// with the greedy choices, and then there is nothing to search for.
+	encode_block_greedy(samples, count, indices);
+
+	uint8_t base = samples[0];
+	bool exact = true;
+
+	for (int i = 1; i < count && exact; i++)
 	{
-		delta->length += (extra + 1) / 2;
+		base += gDeltaEncodingTable[indices[i - 1]];
+		exact = (base == samples[i]);
 	}
 
-	delta->data = malloc(delta->length + 33);
+	if (exact)
+	{
+		return;
+	}
 
-	unsigned int i = 0;
-	unsigned int j = 0;
-	int k;
-	uint8_t base;
-	int delta_index;
+	for (int state = 0; state < 256; state++)
+	{
+		cost[state] = UINT32_MAX;
+	}
+	cost[samples[0]] = 0;
 
-	while (i < pcm->length)
+	for (int i = 1; i < count; i++)
 	{
-		base = pcm->data[i++];
-		delta->data[j++] = base;
+		int sample = (int8_t)samples[i];
 
-		if (i >= pcm->length)
+		for (int state = 0; state < 256; state++)
 		{
-			break;
+			new_cost[state] = UINT32_MAX;
 		}
-		delta_index = get_delta_index(pcm->data[i++], base);
-		base += gDeltaEncodingTable[delta_index];
-		delta->data[j++] = delta_index;
 
-		for (k = 0; k < 31; k++)
+		for (int state = 0; state < 256; state++)
 		{
-			if (i >= pcm->length)
+			if (cost[state] == UINT32_MAX)
 			{
-				break;
+				continue;
 			}
-			delta_index = get_delta_index(pcm->data[i++], base);
-			base += gDeltaEncodingTable[delta_index];
-			delta->data[j] = (delta_index << 4);
 
-			if (i >= pcm->length)
+			for (int delta_index = 0; delta_index < 16; delta_index++)
 			{
-				break;
+				uint8_t next = state + gDeltaEncodingTable[delta_index];
+				int error = sample - (int8_t)next;
+				uint32_t next_cost = cost[state] + error * error;
+
+				if (next_cost < new_cost[next])
+				{
+					new_cost[next] = next_cost;
+					from_state[i - 1][next] = state;
+					from_index[i - 1][next] = delta_index;
+				}
 			}
-			delta_index = get_delta_index(pcm->data[i++], base);
-			base += gDeltaEncodingTable[delta_index];
-			delta->data[j++] |= delta_index;
 		}
+
+		memcpy(cost, new_cost, sizeof(cost));
+	}
+
+	int best_state = 0;
+
+	for (int state = 1; state < 256; state++)
+	{
+		if (cost[state] < cost[best_state])
+		{
+			best_state = state;
+		}
+	}
+
+	for (int i = count - 1; i >= 1; i--)
+	{
+		indices[i - 1] = from_index[i - 1][best_state];
+		best_state = from_state[i - 1][best_state];
+	}
+}
+
+// Each block of 64 samples is stored as its first sample, the delta index of the second sample
+// in a byte of its own, and then the remaining 62 delta indices two to a byte, high nybble first.
+struct Bytes *delta_compress(struct Bytes *pcm, bool trellis)
+{
+	struct Bytes *delta = malloc(sizeof(struct Bytes));
+	delta->data = malloc(pcm->length / 64 * 33 + 33);
+
+	unsigned long i = 0;
+	unsigned long j = 0;
+	uint8_t indices[63];
+
+	while (i < pcm->length)
+	{
+		int count = pcm->length - i < 64 ? pcm->length - i : 64;
+
+		if (trellis)
+		{
+			encode_block_trellis(&pcm->data[i], count, indices);
+		}
+		else
+		{
+			encode_block_greedy(&pcm->data[i], count, indices);
+		}
+
+		delta->data[j++] = pcm->data[i];
+
+		if (count > 1)
+		{
+			delta->data[j++] = indices[0];
+		}
+
+		// An odd delta index left over at the very end isn't stored.
+		for (int k = 1; k + 1 < count - 1; k += 2)
+		{
+			delta->data[j++] = (indices[k] << 4) | indices[k + 1];
+		}
+
+		i += count;
 	}
 
 	delta->length = j;
@@ -524,7 +631,7 @@ do { \
 } while (0)
 
 // Reads an .aif file and produces a .pcm file containing an array of 8-bit samples.
-void aif2pcm(const char *aif_filename, const char *pcm_filename, bool compress)
+void aif2pcm(const char *aif_filename, const char *pcm_filename, bool compress, bool trellis)
 {
 	struct Bytes *aif = read_bytearray(aif_filename);
 	AifData aif_data = {0,0,0,0,0,0,0};
@@ -539,7 +646,7 @@ void aif2pcm(const char *aif_filename, const char *pcm_filename, bool compress)
 		struct Bytes *input = malloc(sizeof(struct Bytes));
 		input->data = aif_data.samples;
 		input->length = aif_data.real_num_samples;
-		pcm = delta_compress(input);
+		pcm = delta_compress(input, trellis);
 		free(input);
 	}
 	else
@@ -821,10 +928,121 @@ void pcm2aif(const char *pcm_filename, const char *aif_filename, uint32_t base_n
 	free(aif);
 }
 
+#ifndef _MSC_VER
+
+struct BatchJob {
+	char **aif_filenames;
+	int count;
+	int next;
+	pthread_mutex_t lock;
+	bool compress;
+	bool trellis;
+};
+
+void *batch_worker(void *arg)
+{
+	struct BatchJob *job = arg;
+
+	for (;;)
+	{
+		pthread_mutex_lock(&job->lock);
+		int i = job->next++;
+		pthread_mutex_unlock(&job->lock);
+
+		if (i >= job->count)
+		{
+			break;
+		}
+
+		char *bin_filename = new_file_extension(job->aif_filenames[i], "bin");
+		aif2pcm(job->aif_filenames[i], bin_filename, job->compress, job->trellis);
+		free(bin_filename);
+	}
+
+	return NULL;
+}
+
+// Converts every .aif file in a directory to a .bin file next to it, spread across threads.
+void aif2pcm_batch(const char *dir_name, bool compress, bool trellis)
+{
+	DIR *dir = opendir(dir_name);
+	if (!dir)
+	{
+		FATAL_ERROR("Failed to open directory '%s'!\n", dir_name);
+	}
+
+	struct BatchJob job = {0};
+	int capacity = 0;
+	struct dirent *entry;
+
+	while ((entry = readdir(dir)) != NULL)
+	{
+		char *extension = get_file_extension(entry->d_name);
+		if (!extension || (strcmp(extension, "aif") != 0 && strcmp(extension, "aiff") != 0))
+		{
+			continue;
+		}
+
+		if (job.count == capacity)
+		{
+			capacity = capacity ? capacity * 2 : 256;
+			job.aif_filenames = realloc(job.aif_filenames, capacity * sizeof(char *));
+		}
+
+		char *filename = malloc(strlen(dir_name) + 1 + strlen(entry->d_name) + 1);
+		sprintf(filename, "%s/%s", dir_name, entry->d_name);
+		job.aif_filenames[job.count++] = filename;
+	}
+
+	closedir(dir);
+
+	// The threads share the delta index table, so fill it in before they start.
+	fill_delta_index_table();
+
+	pthread_mutex_init(&job.lock, NULL);
+	job.compress = compress;
+	job.trellis = trellis;
+
+	long num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (num_threads < 1)
+	{
+		num_threads = 1;
+	}
+
+	pthread_t *threads = malloc(num_threads * sizeof(pthread_t));
+
+	for (long i = 1; i < num_threads; i++)
+	{
+		if (pthread_create(&threads[i], NULL, batch_worker, &job) != 0)
+		{
+			FATAL_ERROR("Failed to start a thread!\n");
+		}
+	}
+
+	batch_worker(&job);
+
+	for (long i = 1; i < num_threads; i++)
+	{
+		pthread_join(threads[i], NULL);
+	}
+
+	pthread_mutex_destroy(&job.lock);
+	free(threads);
+
+	for (int i = 0; i < job.count; i++)
+	{
+		free(job.aif_filenames[i]);
+	}
+	free(job.aif_filenames);
+}
+
+#endif // _MSC_VER
+
 void usage(void)
 {
 	fprintf(stderr, "Usage: aif2pcm bin_file [aif_file]\n");
-	fprintf(stderr, "       aif2pcm aif_file [bin_file] [--compress]\n");
+	fprintf(stderr, "       aif2pcm aif_file [bin_file] [--compress] [--trellis]\n");
+	fprintf(stderr, "       aif2pcm --batch aif_dir [--compress] [--trellis]\n");
 }
 
 int main(int argc, char **argv)
@@ -835,53 +1053,79 @@ int main(int argc, char **argv)
 		exit(1);
 	}
 
-	char *input_file = argv[1];
-	char *extension = get_file_extension(input_file);
-	char *output_file;
 	bool compressed = false;
+	bool trellis = false;
 
-	if (argc > 3)
+	for (int i = 3; i < argc; i++)
 	{
-		for (int i = 3; i < argc; i++)
+		if (strcmp(argv[i], "--compress") == 0)
 		{
-			if (strcmp(argv[i], "--compress") == 0)
-			{
-				compressed = true;
-			}
+			compressed = true;
+		}
+		else if (strcmp(argv[i], "--trellis") == 0)
+		{
+			trellis = true;
 		}
 	}
 
-	if (strcmp(extension, "aif") == 0 || strcmp(extension, "aiff") == 0)
+	if (strcmp(argv[1], "--batch") == 0)
 	{
-		if (argc >= 3)
-		{
-			output_file = argv[2];
-			aif2pcm(input_file, output_file, compressed);
-		}
-		else
+		if (argc < 3)
 		{
-			output_file = new_file_extension(input_file, "bin");
-			aif2pcm(input_file, output_file, compressed);
-			free(output_file);
+			usage();
+			exit(1);
 		}
+#ifdef _MSC_VER
+		FATAL_ERROR("--batch isn't supported in this build.\n");
+#else
+		aif2pcm_batch(argv[2], compressed, trellis);
+#endif
+		return 0;
+	}
+
+	char *input_file = argv[1];
+	char *extension = get_file_extension(input_file);
+	char *output_file;
+	bool to_pcm;
+
+	if (strcmp(extension, "aif") == 0 || strcmp(extension, "aiff") == 0)
+	{
+		to_pcm = true;
+		output_file = (argc >= 3) ? argv[2] : new_file_extension(input_file, "bin");
 	}
 	else if (strcmp(extension, "bin") == 0)
 	{
-		if (argc >= 3)
+		to_pcm = false;
+		output_file = (argc >= 3) ? argv[2] : new_file_extension(input_file, "aif");
+	}
+	else
+	{
+		FATAL_ERROR("Input file must be .aif or .bin: '%s'\n", input_file);
+	}
+
+	struct ToolCache *cache = ToolCacheBegin(argc, argv);
+
+	ToolCacheAddInput(cache, input_file);
+
+	if (!ToolCacheRestore(cache))
+	{
+		const char *path = ToolCacheAddOutput(cache, output_file);
+
+		if (to_pcm)
 		{
-			output_file = argv[2];
-			pcm2aif(input_file, output_file, 60);
+			aif2pcm(input_file, path, compressed, trellis);
 		}
 		else
 		{
-			output_file = new_file_extension(input_file, "aif");
-			pcm2aif(input_file, output_file, 60);
-			free(output_file);
+			pcm2aif(input_file, path, 60);
 		}
 	}
-	else
+
+	ToolCacheFinish(cache);
+
+	if (argc < 3)
 	{
-		FATAL_ERROR("Input file must be .aif or .bin: '%s'\n", input_file);
+		free(output_file);
 	}
 
 	return 0;
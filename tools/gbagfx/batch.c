@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "global.h"
+#include "util.h"
+#include "batch.h"
+
+// A batch manifest has one conversion per line, written exactly as the
+// arguments that would follow "gbagfx" on the command line:
+//
+//     graphics/foo.png graphics/foo.4bpp -mwidth 2 -mheight 4
+//     graphics/foo.4bpp graphics/foo.4bpp.lz
+//
+// Blank lines and lines starting with '#' are ignored. A job whose input is
+// the output of an earlier job waits for that job to finish, so a manifest
+// written in dependency order (such as the one "make -n" prints) can be run
+// on any number of threads.
+
+struct BatchJob {
+    int argc;
+    char **argv;
+    int dependency;
+    bool done;
+};
+
+struct Batch {
+    struct BatchJob *jobs;
+    int numJobs;
+    int nextJob;
+    pthread_mutex_t mutex;
+    pthread_cond_t jobDone;
+};
+
+static char *SkipSpace(char *s)
+{
+    while (*s != '\n' && *s != 0 && isspace((unsigned char)*s))
+        s++;
+
+    return s;
+}
+
+static int ParseManifest(char *manifest, struct BatchJob **jobs_p)
+{
+    int maxJobs = 1;
+
+    for (char *s = manifest; *s != 0; s++)
+        if (*s == '\n')
+            maxJobs++;
+
+    struct BatchJob *jobs = malloc(maxJobs * sizeof(struct BatchJob));
+
+    if (jobs == NULL)
+        FATAL_ERROR("Failed to allocate memory for batch jobs.\n");
+
+    int numJobs = 0;
+    char *s = manifest;
+
+    while (*s != 0)
+    {
+        char *line = SkipSpace(s);
+        char *lineEnd = strchr(line, '\n');
+
+        if (lineEnd == NULL)
+            lineEnd = line + strlen(line);
+
+        s = (*lineEnd == '\n') ? lineEnd + 1 : lineEnd;
+
+        if (line == lineEnd || *line == '#')
+            continue;
+
+        *lineEnd = 0;
+
+        // Each argument is at least one character followed by a separator.
+        int maxArgs = 1 + (lineEnd - line + 1) / 2 + 1;
+        char **argv = malloc(maxArgs * sizeof(char *));
+
+        if (argv == NULL)
+            FATAL_ERROR("Failed to allocate memory for batch job arguments.\n");
+
+        int argc = 0;
+        argv[argc++] = "gbagfx";
+
+        char *arg = line;
+
+        while (*arg != 0)
+        {
+            argv[argc++] = arg;
+
+            while (*arg != 0 && !isspace((unsigned char)*arg))
+                arg++;
+
+            if (*arg != 0)
+                *arg++ = 0;
+
+            while (*arg != 0 && isspace((unsigned char)*arg))
+                arg++;
+        }
+
+        argv[argc] = NULL;
+
+        if (argc < 3)
+            FATAL_ERROR("Batch job \"%s\" needs an input and an output path.\n", line);
+
+        struct BatchJob *job = &jobs[numJobs];
+        job->argc = argc;
+        job->argv = argv;
+        job->dependency = -1;
+        job->done = false;
+
+        for (int i = numJobs - 1; i >= 0; i--)
+        {
+            if (strcmp(jobs[i].argv[2], argv[1]) == 0)
+            {
+                job->dependency = i;
+                break;
+            }
+        }
+
+        numJobs++;
+    }
+
+    *jobs_p = jobs;
+    return numJobs;
+}
+
+static void *BatchWorker(void *arg)
+{
+    struct Batch *batch = arg;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&batch->mutex);
+
+        if (batch->nextJob >= batch->numJobs)
+        {
+            pthread_mutex_unlock(&batch->mutex);
+            return NULL;
+        }
+
+        // Jobs are handed out in manifest order, so a dependency has always
+        // been picked up by another worker already and waiting cannot deadlock.
+        struct BatchJob *job = &batch->jobs[batch->nextJob++];
+
+        while (job->dependency >= 0 && !batch->jobs[job->dependency].done)
+            pthread_cond_wait(&batch->jobDone, &batch->mutex);
+
+        pthread_mutex_unlock(&batch->mutex);
+
+        ConvertFile(job->argc, job->argv, NULL);
+
+        pthread_mutex_lock(&batch->mutex);
+        job->done = true;
+        pthread_cond_broadcast(&batch->jobDone);
+        pthread_mutex_unlock(&batch->mutex);
+    }
+}
+
+void RunBatch(char *manifestPath, int numThreads)
+{
+    int fileSize;
+    char *manifest = (char *)ReadWholeFileZeroPadded(manifestPath, &fileSize, 1);
+
+    struct Batch batch;
+    batch.numJobs = ParseManifest(manifest, &batch.jobs);
+    batch.nextJob = 0;
+    pthread_mutex_init(&batch.mutex, NULL);
+    pthread_cond_init(&batch.jobDone, NULL);
+
+    if (numThreads < 1)
+    {
+#ifdef _SC_NPROCESSORS_ONLN
+        numThreads = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+        if (numThreads < 1)
+            numThreads = 1;
+    }
+
+    if (numThreads > batch.numJobs)
+        numThreads = batch.numJobs;
+
+    pthread_t *threads = malloc(numThreads * sizeof(pthread_t));
+
+    if (threads == NULL && numThreads > 0)
+        FATAL_ERROR("Failed to allocate memory for batch threads.\n");
+
+    for (int i = 0; i < numThreads; i++)
+        if (pthread_create(&threads[i], NULL, BatchWorker, &batch) != 0)
+            FATAL_ERROR("Failed to create batch thread.\n");
+
+    for (int i = 0; i < numThreads; i++)
+        pthread_join(threads[i], NULL);
+
+    pthread_cond_destroy(&batch.jobDone);
+    pthread_mutex_destroy(&batch.mutex);
+
+    for (int i = 0; i < batch.numJobs; i++)
+        free(batch.jobs[i].argv);
+
+    free(threads);
+    free(batch.jobs);
+    free(manifest);
+}
@@ -0,0 +1,9 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+struct ToolCache;
+
+void ConvertFile(int argc, char **argv, struct ToolCache *cache);
+void RunBatch(char *manifestPath, int numThreads);
+
+#endif // BATCH_H
@@ -0,0 +1,188 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include "global.h"
+#include "util.h"
+#include "gfx.h"
+#include "lz.h"
+#include "rl.h"
+#include "huff.h"
+
+// Times gbagfx's compressors and tile conversion on the contents of the given
+// files, joined into one buffer, and checks that everything round-trips. A
+// real gbagfx run is dominated by process startup and libpng, so this is the
+// way to see a change to the codecs themselves. Build it with "make bench" and run it on files
+// from a ROM build:
+//
+//     ./gbagfx-bench [-passes N] ../../graphics/pokemon/*/front.4bpp
+//
+// To compare against an older gbagfx, build this file against that
+// version's sources.
+
+static int sPasses = 20;
+
+// Tile conversion only works on files, so the tiles go through this one.
+static char sTempPath[] = "gbagfx-bench.tmp";
+
+static double Now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void Report(const char *name, int size, double seconds)
+{
+    double perPass = seconds / sPasses;
+
+    printf("  %-22s %9.3f ms %9.1f MB/s\n", name, perPass * 1e3, size / perPass / 1e6);
+}
+
+static void CheckRoundTrip(const char *name, unsigned char *src, int srcSize, unsigned char *result, int resultSize)
+{
+    if (result == NULL || resultSize != srcSize || memcmp(result, src, srcSize) != 0)
+        FATAL_ERROR("%s didn't reproduce its input.\n", name);
+}
+
+// The compressors take one option: LZ whether to use the optimal parse and
+// Huffman the bit depth. RL has none.
+typedef unsigned char *(*CompressFunc)(unsigned char *src, int srcSize, int *compressedSize, int option);
+typedef unsigned char *(*DecompressFunc)(unsigned char *src, int srcSize, int *uncompressedSize);
+
+static unsigned char *CompressLZ(unsigned char *src, int srcSize, int *compressedSize, int optimal)
+{
+    return LZCompress(src, srcSize, compressedSize, 2, optimal);
+}
+
+static unsigned char *CompressRL(unsigned char *src, int srcSize, int *compressedSize, int option UNUSED)
+{
+    return RLCompress(src, srcSize, compressedSize);
+}
+
+static void BenchCodec(const char *name, CompressFunc compress, DecompressFunc decompress, int option, unsigned char *src, int srcSize)
+{
+    unsigned char *compressed = NULL;
+    int compressedSize = 0;
+    double start = Now();
+
+    for (int i = 0; i < sPasses; i++)
+    {
+        free(compressed);
+        compressed = compress(src, srcSize, &compressedSize, option);
+    }
+
+    double compressTime = Now() - start;
+    unsigned char *decompressed = NULL;
+    int decompressedSize = 0;
+
+    start = Now();
+
+    for (int i = 0; i < sPasses; i++)
+    {
+        free(decompressed);
+        decompressed = decompress(compressed, compressedSize, &decompressedSize);
+    }
+
+    double decompressTime = Now() - start;
+
+    CheckRoundTrip(name, src, srcSize, decompressed, decompressedSize);
+    printf("%s: %d -> %d bytes (%.1f%%)\n", name, srcSize, compressedSize, 100.0 * compressedSize / srcSize);
+    Report("compress", srcSize, compressTime);
+    Report("decompress", srcSize, decompressTime);
+    free(compressed);
+    free(decompressed);
+}
+
+// Converts the input as a 16 tile wide image of 2x2 metatiles, which
+// exercises the metatile walk as well as the pixel conversion. Reading and
+// writing the tile file are timed too, but are small next to the conversion.
+static void BenchTiles(unsigned char *src, int srcSize, int bitDepth)
+{
+    int tileSize = bitDepth * 8;
+    int numTiles = srcSize / tileSize / 32 * 32;
+    struct Image image;
+    char name[32];
+
+    if (numTiles == 0)
+        return;
+
+    WriteWholeFile(sTempPath, src, numTiles * tileSize);
+    memset(&image, 0, sizeof(image));
+
+    double start = Now();
+
+    for (int i = 0; i < sPasses; i++)
+    {
+        FreeImage(&image);
+        ReadImage(sTempPath, 16, bitDepth, 2, 2, &image, false);
+    }
+
+    double fromTime = Now() - start;
+
+    start = Now();
+
+    for (int i = 0; i < sPasses; i++)
+        WriteImage(sTempPath, numTiles, bitDepth, 2, 2, &image, false);
+
+    double toTime = Now() - start;
+    int resultSize;
+    unsigned char *result = ReadWholeFile(sTempPath, &resultSize);
+
+    snprintf(name, sizeof(name), "%dbpp tiles", bitDepth);
+    CheckRoundTrip(name, src, numTiles * tileSize, result, resultSize);
+    printf("%s: %d tiles\n", name, numTiles);
+    Report("from tiles", numTiles * tileSize, fromTime);
+    Report("to tiles", numTiles * tileSize, toTime);
+    free(result);
+    FreeImage(&image);
+    remove(sTempPath);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned char *src = NULL;
+    int srcSize = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-passes") == 0)
+        {
+            if (i + 1 >= argc || (sPasses = atoi(argv[++i])) <= 0)
+                FATAL_ERROR("Expected a number of passes after \"-passes\".\n");
+            continue;
+        }
+
+        int fileSize;
+        unsigned char *data = ReadWholeFile(argv[i], &fileSize);
+
+        src = realloc(src, srcSize + fileSize);
+
+        if (src == NULL)
+            FATAL_ERROR("Failed to allocate memory for the input.\n");
+
+        memcpy(src + srcSize, data, fileSize);
+        srcSize += fileSize;
+        free(data);
+    }
+
+    if (srcSize == 0)
+        FATAL_ERROR("Usage: gbagfx-bench [-passes N] FILE...\n");
+
+    printf("%d bytes, %d passes\n", srcSize, sPasses);
+    BenchCodec("lz", CompressLZ, LZDecompress, false, src, srcSize);
+    BenchCodec("lz -optimal", CompressLZ, LZDecompress, true, src, srcSize);
+    BenchCodec("rl", CompressRL, RLDecompress, 0, src, srcSize);
+    BenchCodec("huff -depth 4", HuffCompress, HuffDecompress, 4, src, srcSize);
+    BenchCodec("huff -depth 8", HuffCompress, HuffDecompress, 8, src, srcSize);
+    BenchTiles(src, srcSize, 1);
+    BenchTiles(src, srcSize, 4);
+    BenchTiles(src, srcSize, 8);
+
+    free(src);
+    return 0;
+}
@@ -45,38 +45,54 @@ static FILE *PngReadOpen(char *path, png_structp *pngStruct, png_infop *pngInfo)
     return fp;
 }
 
-static unsigned char *ConvertBitDepth(unsigned char *src, int srcBitDepth, int destBitDepth, int numPixels)
+// Repacks PNG rows into one continuous run of pixels at another bit depth,
+// most significant pixel first like the rows themselves.
+struct BitDepthConverter
 {
-    // Round the number of bits up to the next 8 and divide by 8 to get the number of bytes.
-    int srcSize = ((numPixels * srcBitDepth + 7) & ~7) / 8;
-    int destSize = ((numPixels * destBitDepth + 7) & ~7) / 8;
-    unsigned char *output = calloc(destSize, 1);
-    unsigned char *dest = output;
-    int i;
-    int j;
-    int destBit = 8 - destBitDepth;
-
-    for (i = 0; i < srcSize; i++)
+    int srcBitDepth;
+    int destBitDepth;
+    unsigned char *dest;
+    int destBit;
+};
+
+static void ConvertRowBitDepth(struct BitDepthConverter *converter, unsigned char *src, int width)
+{
+    int srcBitDepth = converter->srcBitDepth;
+    int destBitDepth = converter->destBitDepth;
+    unsigned char *dest = converter->dest;
+    int destBit = converter->destBit;
+    int i = 0;
+
+    // 8bpp indexed images holding 16 colors are by far the most common case,
+    // so pack those a byte at a time.
+    if (srcBitDepth == 8 && destBitDepth == 4 && destBit == 4)
     {
-        unsigned char srcByte = src[i];
+        for (; i + 2 <= width; i += 2)
+        {
+            if ((src[i] | src[i + 1]) >= 16)
+                break;
+            *dest++ = (src[i] << 4) | src[i + 1];
+        }
+    }
 
-        for (j = 8 - srcBitDepth; j >= 0; j -= srcBitDepth)
+    for (; i < width; i++)
+    {
+        int srcBit = 8 - srcBitDepth - (i * srcBitDepth) % 8;
+        unsigned char pixel = (src[(i * srcBitDepth) / 8] >> srcBit) & ((1 << srcBitDepth) - 1);
+
+        if (pixel >= (1 << destBitDepth))
+            FATAL_ERROR("Image exceeds the maximum color value for a %ibpp image.\n", destBitDepth);
+        *dest |= pixel << destBit;
+        destBit -= destBitDepth;
+        if (destBit < 0)
         {
-            unsigned char pixel = (srcByte >> j) % (1 << srcBitDepth);
-
-            if (pixel >= (1 << destBitDepth))
-                FATAL_ERROR("Image exceeds the maximum color value for a %ibpp image.\n", destBitDepth);
-            *dest |= pixel << destBit;
-            destBit -= destBitDepth;
-            if (destBit < 0)
-            {
-                dest++;
-                destBit = 8 - destBitDepth;
-            }
+            dest++;
+            destBit = 8 - destBitDepth;
         }
     }
 
-    return output;
+    converter->dest = dest;
+    converter->destBit = destBit;
 }
 
 void ReadPng(char *path, struct Image *image)
@@ -101,40 +117,83 @@ void ReadPng(char *path, struct Image *image)
     image->height = png_get_image_height(png_ptr, info_ptr);
 
     int rowbytes = png_get_rowbytes(png_ptr, info_ptr);
+    bool convert = (bit_depth != image->bitDepth && image->tilemap.data.affine == NULL);
 
-    image->pixels = malloc(image->height * rowbytes);
-
-    if (image->pixels == NULL)
-        FATAL_ERROR("Failed to allocate pixel buffer.\n");
-
-    png_bytepp row_pointers = malloc(image->height * sizeof(png_bytep));
+    if (!convert)
+    {
+        image->pixels = malloc(image->height * rowbytes);
 
-    if (row_pointers == NULL)
-        FATAL_ERROR("Failed to allocate row pointers.\n");
+        if (image->pixels == NULL)
+            FATAL_ERROR("Failed to allocate pixel buffer.\n");
 
-    for (int i = 0; i < image->height; i++)
-        row_pointers[i] = (png_bytep)(image->pixels + (i * rowbytes));
+        png_bytepp row_pointers = malloc(image->height * sizeof(png_bytep));
 
-    if (setjmp(png_jmpbuf(png_ptr)))
-        FATAL_ERROR("Error reading from \"%s\".\n", path);
+        if (row_pointers == NULL)
+            FATAL_ERROR("Failed to allocate row pointers.\n");
 
-    png_read_image(png_ptr, row_pointers);
+        for (int i = 0; i < image->height; i++)
+            row_pointers[i] = (png_bytep)(image->pixels + (i * rowbytes));
 
-    png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+        if (setjmp(png_jmpbuf(png_ptr)))
+            FATAL_ERROR("Error reading from \"%s\".\n", path);
 
-    free(row_pointers);
-    fclose(fp);
+        png_read_image(png_ptr, row_pointers);
 
-    if (bit_depth != image->bitDepth && image->tilemap.data.affine == NULL)
+        free(row_pointers);
+    }
+    else
     {
-        unsigned char *src = image->pixels;
-
         if (bit_depth != 1 && bit_depth != 2 && bit_depth != 4 && bit_depth != 8)
             FATAL_ERROR("Bit depth of image must be 1, 2, 4, or 8.\n");
-        image->pixels = ConvertBitDepth(image->pixels, bit_depth, image->bitDepth, image->width * image->height);
-        free(src);
+
+        // Round the number of bits up to the next 8 and divide by 8 to get the number of bytes.
+        int destSize = ((image->width * image->height * image->bitDepth + 7) & ~7) / 8;
+
+        image->pixels = calloc(destSize, 1);
+
+        if (image->pixels == NULL)
+            FATAL_ERROR("Failed to allocate pixel buffer.\n");
+
+        // Each row is converted as soon as it's decoded, so only interlaced
+        // images need all of the PNG's own rows at once.
+        int numPasses = png_set_interlace_handling(png_ptr);
+        int numRows = numPasses > 1 ? image->height : 1;
+        unsigned char *rows = malloc(numRows * rowbytes);
+
+        if (rows == NULL)
+            FATAL_ERROR("Failed to allocate pixel buffer.\n");
+
+        struct BitDepthConverter converter = { bit_depth, image->bitDepth, image->pixels, 8 - image->bitDepth };
+
+        if (setjmp(png_jmpbuf(png_ptr)))
+            FATAL_ERROR("Error reading from \"%s\".\n", path);
+
+        if (numPasses > 1)
+        {
+            for (int pass = 0; pass < numPasses; pass++)
+                for (int i = 0; i < image->height; i++)
+                    png_read_row(png_ptr, rows + i * rowbytes, NULL);
+        }
+
+        for (int i = 0; i < image->height; i++)
+        {
+            unsigned char *row = rows;
+
+            if (numPasses > 1)
+                row += i * rowbytes;
+            else
+                png_read_row(png_ptr, row, NULL);
+
+            ConvertRowBitDepth(&converter, row, image->width);
+        }
+
+        free(rows);
         image->bitDepth = bit_depth;
     }
+
+    png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+
+    fclose(fp);
 }
 
 void ReadPngPalette(char *path, struct Palette *palette)
@@ -185,7 +244,7 @@ void SetPngPalette(png_structp png_ptr, png_infop info_ptr, struct Palette *pale
     free(colors);
 }
 
-void WritePng(char *path, struct Image *image)
+void WritePng(char *path, struct Image *image, struct PngCompression *compression)
 {
     FILE *fp = fopen(path, "wb");
 
@@ -206,6 +265,8 @@ void WritePng(char *path, struct Image *image)
         FATAL_ERROR("Failed to init I/O for writing \"%s\".\n", path);
 
     png_init_io(png_ptr, fp);
+    png_set_compression_level(png_ptr, compression->level);
+    png_set_compression_strategy(png_ptr, compression->strategy);
 
     if (setjmp(png_jmpbuf(png_ptr)))
         FATAL_ERROR("Error writing header for \"%s\".\n", path);
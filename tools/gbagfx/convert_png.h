@@ -3,10 +3,20 @@
 #ifndef CONVERT_PNG_H
 #define CONVERT_PNG_H
 
+#include <zlib.h>
 #include "gfx.h"
 
+// zlib settings for WritePng.
+struct PngCompression {
+    int level;
+    int strategy;
+};
+
+// PNGs made from GBA data are only dumped for inspection, so favor speed.
+#define PNG_COMPRESSION_FAST { Z_BEST_SPEED, Z_DEFAULT_STRATEGY }
+
 void ReadPng(char *path, struct Image *image);
-void WritePng(char *path, struct Image *image);
+void WritePng(char *path, struct Image *image, struct PngCompression *compression);
 void ReadPngPalette(char *path, struct Palette *palette);
 
 #endif // CONVERT_PNG_H
@@ -5,6 +5,9 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "global.h"
 #include "gfx.h"
 #include "util.h"
@@ -36,170 +39,118 @@ static void AdvanceMetatilePosition(int *subTileX, int *subTileY, int *metatileX
 	}
 }
 
-static void ConvertFromTiles1Bpp(unsigned char *src, unsigned char *dest, int numTiles, int metatilesWide, int metatileWidth, int metatileHeight, bool invertColors)
+// Reverses the order of the bits within each byte.
+static inline uint64_t ReverseBitsInBytes(uint64_t x)
 {
-	int subTileX = 0;
-	int subTileY = 0;
-	int metatileX = 0;
-	int metatileY = 0;
-	int pitch = metatilesWide * metatileWidth;
-
-	for (int i = 0; i < numTiles; i++) {
-		for (int j = 0; j < 8; j++) {
-			int destY = (metatileY * metatileHeight + subTileY) * 8 + j;
-			int destX = metatileX * metatileWidth + subTileX;
-			unsigned char srcPixelOctet = *src++;
-			unsigned char *destPixelOctet = &dest[destY * pitch + destX];
-
-			for (int k = 0; k < 8; k++) {
-				*destPixelOctet <<= 1;
-				*destPixelOctet |= (srcPixelOctet & 1) ^ invertColors;
-				srcPixelOctet >>= 1;
-			}
-		}
+	x = ((x >> 1) & 0x5555555555555555ULL) | ((x & 0x5555555555555555ULL) << 1);
+	x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+	x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+	return x;
+}
 
-		AdvanceMetatilePosition(&subTileX, &subTileY, &metatileX, &metatileY, metatilesWide, metatileWidth, metatileHeight);
-	}
+static inline uint64_t SwapNybblesInBytes(uint64_t x)
+{
+	return ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
 }
 
-static void ConvertFromTiles4Bpp(unsigned char *src, unsigned char *dest, int numTiles, int metatilesWide, int metatileWidth, int metatileHeight, bool invertColors)
+// Converts the pixels of one tile between the GBA's layout and the image's.
+// The GBA stores the leftmost pixel in the lowest bits of each byte, which is
+// the reverse of the image order, so the conversion is the same both ways.
+// The tile is 8 * bitDepth bytes, i.e. 8, 32 or 64.
+static void ConvertTilePixels(unsigned char *tile, int bitDepth, bool invertColors)
 {
-	int subTileX = 0;
-	int subTileY = 0;
-	int metatileX = 0;
-	int metatileY = 0;
-	int pitch = (metatilesWide * metatileWidth) * 4;
+	int tileSize = bitDepth * 8;
 
-	for (int i = 0; i < numTiles; i++) {
-		for (int j = 0; j < 8; j++) {
-			int destY = (metatileY * metatileHeight + subTileY) * 8 + j;
+#ifdef __SSE2__
+	if (bitDepth != 1) {
+		__m128i lowMask = _mm_set1_epi8(0x0F);
+		__m128i invert = _mm_set1_epi8(invertColors ? 0xFF : 0);
 
-			for (int k = 0; k < 4; k++) {
-				int destX = (metatileX * metatileWidth + subTileX) * 4 + k;
-				unsigned char srcPixelPair = *src++;
-				unsigned char leftPixel = srcPixelPair & 0xF;
-				unsigned char rightPixel = srcPixelPair >> 4;
+		for (int i = 0; i < tileSize; i += 16) {
+			__m128i v = _mm_loadu_si128((__m128i *)&tile[i]);
 
-				if (invertColors) {
-					leftPixel = 15 - leftPixel;
-					rightPixel = 15 - rightPixel;
-				}
+			if (bitDepth == 4)
+				v = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(v, 4), lowMask), _mm_slli_epi16(_mm_and_si128(v, lowMask), 4));
 
-				dest[destY * pitch + destX] = (leftPixel << 4) | rightPixel;
-			}
+			_mm_storeu_si128((__m128i *)&tile[i], _mm_xor_si128(v, invert));
 		}
-
-		AdvanceMetatilePosition(&subTileX, &subTileY, &metatileX, &metatileY, metatilesWide, metatileWidth, metatileHeight);
+		return;
 	}
-}
+#endif
 
-static void ConvertFromTiles8Bpp(unsigned char *src, unsigned char *dest, int numTiles, int metatilesWide, int metatileWidth, int metatileHeight, bool invertColors)
-{
-	int subTileX = 0;
-	int subTileY = 0;
-	int metatileX = 0;
-	int metatileY = 0;
-	int pitch = (metatilesWide * metatileWidth) * 8;
+	uint64_t invert = invertColors ? ~0ULL : 0;
 
-	for (int i = 0; i < numTiles; i++) {
-		for (int j = 0; j < 8; j++) {
-			int destY = (metatileY * metatileHeight + subTileY) * 8 + j;
+	for (int i = 0; i < tileSize; i += 8) {
+		uint64_t v;
 
-			for (int k = 0; k < 8; k++) {
-				int destX = (metatileX * metatileWidth + subTileX) * 8 + k;
-				unsigned char srcPixel = *src++;
+		memcpy(&v, &tile[i], 8);
 
-				if (invertColors)
-					srcPixel = 255 - srcPixel;
+		if (bitDepth == 1)
+			v = ReverseBitsInBytes(v);
+		else if (bitDepth == 4)
+			v = SwapNybblesInBytes(v);
 
-				dest[destY * pitch + destX] = srcPixel;
-			}
-		}
-
-		AdvanceMetatilePosition(&subTileX, &subTileY, &metatileX, &metatileY, metatilesWide, metatileWidth, metatileHeight);
+		v ^= invert;
+		memcpy(&tile[i], &v, 8);
 	}
 }
 
-static void ConvertToTiles1Bpp(unsigned char *src, unsigned char *dest, int numTiles, int metatilesWide, int metatileWidth, int metatileHeight, bool invertColors)
+// Returns the top-left corner of the given tile of the image. A tile row is
+// bitDepth bytes wide.
+static unsigned char *GetTileOrigin(unsigned char *pixels, int pitch, int bitDepth, int subTileX, int subTileY, int metatileX, int metatileY, int metatileWidth, int metatileHeight)
 {
-	int subTileX = 0;
-	int subTileY = 0;
-	int metatileX = 0;
-	int metatileY = 0;
-	int pitch = metatilesWide * metatileWidth;
+	int y = (metatileY * metatileHeight + subTileY) * 8;
+	int x = metatileX * metatileWidth + subTileX;
 
-	for (int i = 0; i < numTiles; i++) {
-		for (int j = 0; j < 8; j++) {
-			int srcY = (metatileY * metatileHeight + subTileY) * 8 + j;
-			int srcX = metatileX * metatileWidth + subTileX;
-			unsigned char srcPixelOctet = src[srcY * pitch + srcX];
-			unsigned char *destPixelOctet = dest++;
-
-			for (int k = 0; k < 8; k++) {
-				*destPixelOctet <<= 1;
-				*destPixelOctet |= (srcPixelOctet & 1) ^ invertColors;
-				srcPixelOctet >>= 1;
-			}
-		}
-
-		AdvanceMetatilePosition(&subTileX, &subTileY, &metatileX, &metatileY, metatilesWide, metatileWidth, metatileHeight);
-	}
+	return &pixels[y * pitch + x * bitDepth];
 }
 
-static void ConvertToTiles4Bpp(unsigned char *src, unsigned char *dest, int numTiles, int metatilesWide, int metatileWidth, int metatileHeight, bool invertColors)
+static void ConvertFromTiles(unsigned char *src, unsigned char *dest, int numTiles, int bitDepth, int metatilesWide, int metatileWidth, int metatileHeight, bool invertColors)
 {
 	int subTileX = 0;
 	int subTileY = 0;
 	int metatileX = 0;
 	int metatileY = 0;
-	int pitch = (metatilesWide * metatileWidth) * 4;
+	int pitch = (metatilesWide * metatileWidth) * bitDepth;
+	int tileSize = bitDepth * 8;
+	unsigned char tile[64];
 
 	for (int i = 0; i < numTiles; i++) {
-		for (int j = 0; j < 8; j++) {
-			int srcY = (metatileY * metatileHeight + subTileY) * 8 + j;
-
-			for (int k = 0; k < 4; k++) {
-				int srcX = (metatileX * metatileWidth + subTileX) * 4 + k;
-				unsigned char srcPixelPair = src[srcY * pitch + srcX];
-				unsigned char leftPixel = srcPixelPair >> 4;
-				unsigned char rightPixel = srcPixelPair & 0xF;
+		unsigned char *destRow = GetTileOrigin(dest, pitch, bitDepth, subTileX, subTileY, metatileX, metatileY, metatileWidth, metatileHeight);
 
-				if (invertColors) {
-					leftPixel = 15 - leftPixel;
-					rightPixel = 15 - rightPixel;
-				}
+		memcpy(tile, src, tileSize);
+		src += tileSize;
+		ConvertTilePixels(tile, bitDepth, invertColors);
 
-				*dest++ = (rightPixel << 4) | leftPixel;
-			}
+		for (int j = 0; j < 8; j++) {
+			memcpy(destRow, &tile[j * bitDepth], bitDepth);
+			destRow += pitch;
 		}
 
 		AdvanceMetatilePosition(&subTileX, &subTileY, &metatileX, &metatileY, metatilesWide, metatileWidth, metatileHeight);
 	}
 }
 
-static void ConvertToTiles8Bpp(unsigned char *src, unsigned char *dest, int numTiles, int metatilesWide, int metatileWidth, int metatileHeight, bool invertColors)
+static void ConvertToTiles(unsigned char *src, unsigned char *dest, int numTiles, int bitDepth, int metatilesWide, int metatileWidth, int metatileHeight, bool invertColors)
 {
 	int subTileX = 0;
 	int subTileY = 0;
 	int metatileX = 0;
 	int metatileY = 0;
-	int pitch = (metatilesWide * metatileWidth) * 8;
+	int pitch = (metatilesWide * metatileWidth) * bitDepth;
+	int tileSize = bitDepth * 8;
 
 	for (int i = 0; i < numTiles; i++) {
-		for (int j = 0; j < 8; j++) {
-			int srcY = (metatileY * metatileHeight + subTileY) * 8 + j;
-
-			for (int k = 0; k < 8; k++) {
-				int srcX = (metatileX * metatileWidth + subTileX) * 8 + k;
-				unsigned char srcPixel = src[srcY * pitch + srcX];
+		unsigned char *srcRow = GetTileOrigin(src, pitch, bitDepth, subTileX, subTileY, metatileX, metatileY, metatileWidth, metatileHeight);
 
-				if (invertColors)
-					srcPixel = 255 - srcPixel;
-
-				*dest++ = srcPixel;
-			}
+		for (int j = 0; j < 8; j++) {
+			memcpy(&dest[j * bitDepth], srcRow, bitDepth);
+			srcRow += pitch;
 		}
 
+		ConvertTilePixels(dest, bitDepth, invertColors);
+		dest += tileSize;
+
 		AdvanceMetatilePosition(&subTileX, &subTileY, &metatileX, &metatileY, metatilesWide, metatileWidth, metatileHeight);
 	}
 }
@@ -212,86 +163,51 @@ static void DecodeAffineTilemap(unsigned char *input, unsigned char *output, uns
     }
 }
 
-#define REVERSE_BIT_ORDER(x) ({ \
-      ((((x) >> 7) & 1) << 0)   \
-    | ((((x) >> 6) & 1) << 1)   \
-    | ((((x) >> 5) & 1) << 2)   \
-    | ((((x) >> 4) & 1) << 3)   \
-    | ((((x) >> 3) & 1) << 4)   \
-    | ((((x) >> 2) & 1) << 5)   \
-    | ((((x) >> 1) & 1) << 6)   \
-    | ((((x) >> 0) & 1) << 7);  \
-})
-
-#define SWAP_BYTES(a, b) ({   \
-    unsigned char tmp = *(a); \
-    *(a) = *(b);              \
-    *(b) = tmp;               \
-})
-
-#define NSWAP(x) ({ (((x) >> 4) & 0xF) | (((x) << 4) & 0xF0); })
-
-#define SWAP_NYBBLES(a, b) ({        \
-    unsigned char tmp = NSWAP(*(a)); \
-    *(a) = NSWAP(*(b));              \
-    *(b) = tmp;                      \
-})
-
+// Flips a tile by swapping its rows, which are bitDepth bytes each.
 static void VflipTile(unsigned char * tile, int bitDepth)
 {
-    int i;
-    switch (bitDepth)
+    unsigned char tmp[8];
+
+    for (int i = 0; i < 4; i++)
     {
-    case 1:
-        SWAP_BYTES(&tile[0], &tile[7]);
-        SWAP_BYTES(&tile[1], &tile[6]);
-        SWAP_BYTES(&tile[2], &tile[5]);
-        SWAP_BYTES(&tile[3], &tile[4]);
-        break;
-    case 4:
-        for (i = 0; i < 4; i++)
-        {
-            SWAP_BYTES(&tile[i + 0], &tile[i + 28]);
-            SWAP_BYTES(&tile[i + 4], &tile[i + 24]);
-            SWAP_BYTES(&tile[i + 8], &tile[i + 20]);
-            SWAP_BYTES(&tile[i + 12], &tile[i + 16]);
-        }
-        break;
-    case 8:
-        for (i = 0; i < 8; i++)
-        {
-            SWAP_BYTES(&tile[i + 0], &tile[i + 56]);
-            SWAP_BYTES(&tile[i + 8], &tile[i + 48]);
-            SWAP_BYTES(&tile[i + 16], &tile[i + 40]);
-            SWAP_BYTES(&tile[i + 24], &tile[i + 32]);
-        }
-        break;
+        unsigned char *top = &tile[i * bitDepth];
+        unsigned char *bottom = &tile[(7 - i) * bitDepth];
+
+        memcpy(tmp, top, bitDepth);
+        memcpy(top, bottom, bitDepth);
+        memcpy(bottom, tmp, bitDepth);
     }
 }
 
+// Flips a tile by reversing the pixels within each row.
 static void HflipTile(unsigned char * tile, int bitDepth)
 {
     int i;
+    uint64_t row;
+    uint32_t halfRow;
+
     switch (bitDepth)
     {
     case 1:
-        for (i = 0; i < 8; i++)
-            tile[i] = REVERSE_BIT_ORDER(tile[i]);
+        memcpy(&row, tile, 8);
+        row = ReverseBitsInBytes(row);
+        memcpy(tile, &row, 8);
         break;
     case 4:
         for (i = 0; i < 8; i++)
         {
-            SWAP_NYBBLES(&tile[4 * i + 0], &tile[4 * i + 3]);
-            SWAP_NYBBLES(&tile[4 * i + 1], &tile[4 * i + 2]);;
+            memcpy(&halfRow, &tile[4 * i], 4);
+            halfRow = __builtin_bswap32(halfRow);
+            halfRow = (uint32_t)SwapNybblesInBytes(halfRow);
+            memcpy(&tile[4 * i], &halfRow, 4);
         }
         break;
     case 8:
         for (i = 0; i < 8; i++)
         {
-            SWAP_BYTES(&tile[8 * i + 0], &tile[8 * i + 7]);
-            SWAP_BYTES(&tile[8 * i + 1], &tile[8 * i + 6]);
-            SWAP_BYTES(&tile[8 * i + 2], &tile[8 * i + 5]);
-            SWAP_BYTES(&tile[8 * i + 3], &tile[8 * i + 4]);
+            memcpy(&row, &tile[8 * i], 8);
+            row = __builtin_bswap64(row);
+            memcpy(&tile[8 * i], &row, 8);
         }
         break;
     }
@@ -382,17 +298,7 @@ void ReadImage(char *path, int tilesWidth, int bitDepth, int metatileWidth, int
 
 	int metatilesWide = tilesWidth / metatileWidth;
 
-	switch (bitDepth) {
-	case 1:
-		ConvertFromTiles1Bpp(buffer, image->pixels, numTiles, metatilesWide, metatileWidth, metatileHeight, invertColors);
-		break;
-	case 4:
-		ConvertFromTiles4Bpp(buffer, image->pixels, numTiles, metatilesWide, metatileWidth, metatileHeight, invertColors);
-		break;
-	case 8:
-		ConvertFromTiles8Bpp(buffer, image->pixels, numTiles, metatilesWide, metatileWidth, metatileHeight, invertColors);
-		break;
-	}
+	ConvertFromTiles(buffer, image->pixels, numTiles, bitDepth, metatilesWide, metatileWidth, metatileHeight, invertColors);
 
 	free(buffer);
 }
@@ -431,17 +337,7 @@ void WriteImage(char *path, int numTiles, int bitDepth, int metatileWidth, int m
 
 	int metatilesWide = tilesWidth / metatileWidth;
 
-	switch (bitDepth) {
-	case 1:
-		ConvertToTiles1Bpp(image->pixels, buffer, numTiles, metatilesWide, metatileWidth, metatileHeight, invertColors);
-		break;
-	case 4:
-		ConvertToTiles4Bpp(image->pixels, buffer, numTiles, metatilesWide, metatileWidth, metatileHeight, invertColors);
-		break;
-	case 8:
-		ConvertToTiles8Bpp(image->pixels, buffer, numTiles, metatilesWide, metatileWidth, metatileHeight, invertColors);
-		break;
-	}
+	ConvertToTiles(image->pixels, buffer, numTiles, bitDepth, metatilesWide, metatileWidth, metatileHeight, invertColors);
 
 	WriteWholeFile(path, buffer, bufferSize);
 
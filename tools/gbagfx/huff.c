@@ -6,212 +6,165 @@
 #include "global.h"
 #include "huff.h"
 
-static int cmp_tree(const void * a0, const void * b0) {
-    return ((struct HuffData *)a0)->value - ((struct HuffData *)b0)->value;
+struct HuffNode {
+    uint32_t value;
+    // Child node indices, or -1 for a leaf.
+    int left;
+    int right;
+    unsigned char key;
+};
+
+// A flat table of the code for each symbol.
+struct HuffCode {
+    uint32_t bits;
+    int length;
+};
+
+static int cmp_leaves(const void * a0, const void * b0) {
+    const struct HuffNode * a = a0;
+    const struct HuffNode * b = b0;
+
+    // Equal frequencies keep the symbol order, as a stable sort would.
+    if (a->value != b->value)
+        return a->value < b->value ? -1 : 1;
+    return a->key - b->key;
 }
 
-typedef int (*cmpfun)(const void *, const void *);
-
-int msort_r(void * data, size_t count, size_t size, cmpfun cmp, void * buffer) {
-    /*
-     * Out-of-place mergesort (stable sort)
-     * Returns 1 on success, 0 on failure
-     */
-    void * leftPtr;
-    void * rightPtr;
-    void * leftEnd;
-    void * rightEnd;
-    int i;
-
-    switch (count) {
-    case 0:
-        // Should never be here
-        return 0;
-
-    case 1:
-        // Nothing to do here
-        break;
-
-    case 2:
-        // Swap the two entries if the right one compares higher.
-        if (cmp(data, data + size) > 0) {
-            memcpy(buffer, data, size);
-            memcpy(data, data + size, size);
-            memcpy(data + size, buffer, size);
-        }
-        break;
-    default:
-        // Merge sort out-of-place.
-        leftPtr = data;
-        leftEnd = rightPtr = data + count / 2 * size;
-        rightEnd = data + count * size;
-
-        // Sort the left half
-        if (!msort_r(leftPtr, count / 2, size, cmp, buffer))
-            return 0;
-
-        // Sort the right half
-        if (!msort_r(rightPtr, count / 2 + (count & 1), size, cmp, buffer))
-            return 0;
-
-        // Merge the sorted halves out of place
-        i = 0;
-        do {
-            if (cmp(leftPtr, rightPtr) <= 0) {
-                memcpy(buffer + i * size, leftPtr, size);
-                leftPtr += size;
-            } else {
-                memcpy(buffer + i * size, rightPtr, size);
-                rightPtr += size;
-            }
-
-        } while (++i < count && leftPtr < leftEnd && rightPtr < rightEnd);
-
-        // Copy the remainder
-        if (i < count) {
-            if (leftPtr < leftEnd) {
-                memcpy(buffer + i * size, leftPtr, leftEnd - leftPtr);
-            }
-            else {
-                memcpy(buffer + i * size, rightPtr, rightEnd - rightPtr);
-            }
+/*
+ * Builds the Huffman tree in nodes[] and returns the index of its root.
+ * nodes[0 .. numLeaves - 1] are the leaves sorted by frequency. The branches
+ * are created in order of increasing frequency after them, so the two
+ * cheapest nodes are always at the front of one of two queues.
+ *
+ * On equal frequencies, a leaf is taken before a branch and an older branch
+ * before a newer one. Each branch's left child is the second node taken.
+ * This gives exactly the tree that repeatedly re-sorting the list (with new
+ * branches added at the end) and merging the first two would give.
+ */
+static int build_tree(struct HuffNode * nodes, int numLeaves) {
+    int nextLeaf = 0;
+    int nextBranch = numLeaves;
+    int numNodes = numLeaves;
+
+    for (int i = 0; i < numLeaves - 1; i++) {
+        int taken[2];
+
+        for (int j = 0; j < 2; j++) {
+            if (nextLeaf < numLeaves && (nextBranch == numNodes || nodes[nextLeaf].value <= nodes[nextBranch].value))
+                taken[j] = nextLeaf++;
+            else
+                taken[j] = nextBranch++;
         }
 
-        // Copy the merged data back
-        memcpy(data, buffer, count * size);
-        break;
+        nodes[numNodes].value = nodes[taken[0]].value + nodes[taken[1]].value;
+        nodes[numNodes].left = taken[1];
+        nodes[numNodes].right = taken[0];
+        numNodes++;
     }
 
-    return 1;
+    return numNodes - 1;
 }
 
-int msort(void * data, size_t count, size_t size, cmpfun cmp) {
-    void * buffer = malloc(count * size);
-    if (buffer == NULL) return 0;
-    int result = msort_r(data, count, size, cmp, buffer);
-    free(buffer);
-    return result;
-}
+/*
+ * Writes the tree breadth-first, which keeps the children of each branch
+ * next to each other, and fills in the code for each symbol.
+ */
+static void write_tree(unsigned char * dest, struct HuffNode * nodes, int root, int numLeaves, struct HuffCode * codes) {
+    int numNodes = 2 * numLeaves - 1;
+    int * order = malloc(numNodes * sizeof(int));
+    uint32_t * paths = malloc(numNodes * sizeof(uint32_t));
+    int * depths = malloc(numNodes * sizeof(int));
 
-static void write_tree(unsigned char * dest, HuffNode_t * tree, int nitems, struct BitEncoding * encoding) {
-    /*
-     * The example used to guide this function encodes the tree in a
-     * breadth-first manner.  We attempt to emulate that here.
-     */
+    if (order == NULL || paths == NULL || depths == NULL)
+        FATAL_ERROR("Fatal error while compressing Huff file.\n");
 
-    int i, j, k;
+    order[0] = root;
+    paths[0] = 0;
+    depths[0] = 0;
 
-    // There are (2 * nitems - 1) nodes in the binary tree.  Allocate that.
-    HuffNode_t * traversal = calloc(2 * nitems - 1, sizeof(HuffNode_t));
-    if (traversal == NULL)
-        FATAL_ERROR("Fatal error while compressing Huff file.\n");
+    int numPlaced = 1;
 
-    // The first node is the root of the tree.
-    traversal[0] = *tree;
-    i = 1;
-
-    // Copy the tree into a breadth-first ordering using brute force.
-    for (int depth = 1; i < 2 * nitems - 1; depth++) {
-        // Consider every possible path up to the current depth.
-        for (j = 0; i < 2 * nitems - 1 && j < 1 << depth; j++) {
-            // The index of the path is used to encode the path itself.
-            // Start from the most significant relevant bit and work our way down.
-            // Keep track of the current and previous nodes.
-            HuffNode_t * currNode = traversal;
-            HuffNode_t * parent = NULL;
-            for (k = 0; k < depth; k++) {
-                if (currNode->header.isLeaf)
-                    break;
-                parent = currNode;
-                if ((j >> (depth - k - 1)) & 1)
-                    currNode = currNode->branch.right;
-                else
-                    currNode = currNode->branch.left;
-            }
-            // Check that the length of the current path equals the current depth.
-            if (k == depth) {
-                // Make sure we can encode the current branch.
-                // Bail here if we cannot.
-                // This is only applicable for 8-bit encodings.
-                if (traversal + i - parent > 128)
-                    FATAL_ERROR("Fatal error while compressing Huff file: unable to encode binary tree.\n");
-                // Copy the current node, and update its parent.
-                traversal[i] = *currNode;
-                if (parent != NULL) {
-                    if ((j & 1) == 1)
-                        parent->branch.right = traversal + i;
-                    else
-                        parent->branch.left = traversal + i;
-                }
-                // Encode the path through the tree in the lookup table
-                if (traversal[i].header.isLeaf) {
-                    encoding[traversal[i].leaf.key].nbits = depth;
-                    encoding[traversal[i].leaf.key].bitstring = j;
-                }
-                i++;
-            }
+    for (int i = 0; i < numNodes; i++) {
+        struct HuffNode * node = &nodes[order[i]];
+
+        if (node->left < 0) {
+            codes[node->key].bits = paths[i];
+            codes[node->key].length = depths[i];
+            dest[5 + i] = node->key;
+            continue;
         }
-    }
 
-    // Encode the size of the tree.
-    // This is used by the decompressor to skip the tree.
-    dest[4] = nitems - 1;
+        // Make sure we can encode the branch and its codes.
+        // This is only applicable for 8-bit encodings.
+        if (numPlaced + 1 - i > 128 || depths[i] >= 32)
+            FATAL_ERROR("Fatal error while compressing Huff file: unable to encode binary tree.\n");
 
-    // Encode each node in the tree.
-    for (i = 0; i < 2 * nitems - 1; i++) {
-        HuffNode_t * currNode = traversal + i;
-        if (currNode->header.isLeaf) {
-            dest[5 + i] = traversal[i].leaf.key;
-        } else {
-            dest[5 + i] = (((currNode->branch.right - traversal - i) / 2) - 1);
-            if (currNode->branch.left->header.isLeaf)
-                dest[5 + i] |= 0x80;
-            if (currNode->branch.right->header.isLeaf)
-                dest[5 + i] |= 0x40;
+        for (int j = 0; j < 2; j++) {
+            order[numPlaced] = j ? node->right : node->left;
+            paths[numPlaced] = (paths[i] << 1) | j;
+            depths[numPlaced] = depths[i] + 1;
+            numPlaced++;
         }
+
+        int right = numPlaced - 1;
+
+        dest[5 + i] = ((right - i) / 2) - 1;
+        if (nodes[node->left].left < 0)
+            dest[5 + i] |= 0x80;
+        if (nodes[node->right].left < 0)
+            dest[5 + i] |= 0x40;
     }
 
-    free(traversal);
+    // Encode the size of the tree.
+    // This is used by the decompressor to skip the tree.
+    dest[4] = numLeaves - 1;
+
+    free(order);
+    free(paths);
+    free(depths);
 }
 
-static inline void write_32_le(unsigned char * dest, int * destPos, uint32_t * buff, int * buffPos) {
-    dest[*destPos] = *buff;
-    dest[*destPos + 1] = *buff >> 8;
-    dest[*destPos + 2] = *buff >> 16;
-    dest[*destPos + 3] = *buff >> 24;
+static inline void write_32_le(unsigned char * dest, int * destPos, uint32_t value) {
+    dest[*destPos] = value;
+    dest[*destPos + 1] = value >> 8;
+    dest[*destPos + 2] = value >> 16;
+    dest[*destPos + 3] = value >> 24;
     *destPos += 4;
-    *buff = 0;
-    *buffPos = 0;
 }
 
-static inline void read_32_le(unsigned char * src, int * srcPos, uint32_t * buff) {
-    uint32_t tmp = src[*srcPos];
-    tmp |= src[*srcPos + 1] << 8;
-    tmp |= src[*srcPos + 2] << 16;
-    tmp |= src[*srcPos + 3] << 24;
-    *srcPos += 4;
-    *buff = tmp;
+static inline uint32_t read_32_le(unsigned char * src, int srcPos, int srcSize) {
+    uint32_t value = 0;
+
+    for (int i = 3; i >= 0; i--)
+        value = (value << 8) | (srcPos + i < srcSize ? src[srcPos + i] : 0);
+    return value;
 }
 
-static void write_bits(unsigned char * dest, int * destPos, struct BitEncoding * encoding, int value, uint32_t * buff, int * buffBits) {
-    int nbits = encoding[value].nbits;
-    uint32_t bitstring = encoding[value].bitstring;
-
-    if (*buffBits + nbits >= 32) {
-        int diff = *buffBits + nbits - 32;
-        *buff <<= nbits - diff;
-        *buff |= bitstring >> diff;
-        bitstring &= ~(1 << diff);
-        nbits = diff;
-        write_32_le(dest, destPos, buff, buffBits);
-    }
-    if (nbits != 0) {
-        *buff <<= nbits;
-        *buff |= bitstring;
-        *buffBits += nbits;
+// Codes are packed most significant bit first into 32-bit little-endian words.
+struct BitWriter {
+    unsigned char * dest;
+    int destPos;
+    // The low numBits bits haven't been written yet.
+    uint64_t buffer;
+    int numBits;
+};
+
+static inline void write_bits(struct BitWriter * writer, uint32_t bits, int length) {
+    writer->buffer = (writer->buffer << length) | bits;
+    writer->numBits += length;
+
+    if (writer->numBits >= 32) {
+        writer->numBits -= 32;
+        write_32_le(writer->dest, &writer->destPos, writer->buffer >> writer->numBits);
     }
 }
 
+// The last, partial word is padded with zeros at the bottom, so its bits
+// come out in the same place as in a full word.
+static void write_last_word(struct BitWriter * writer) {
+    write_32_le(writer->dest, &writer->destPos, writer->buffer << (32 - writer->numBits));
+}
+
 /*
 =======================================
 MAIN COMPRESSION/DECOMPRESSION ROUTINES
@@ -230,120 +183,164 @@ unsigned char * HuffCompress(unsigned char * src, int srcSize, int * compressedS
 
     int nitems = 1 << bitDepth;
 
-    HuffNode_t * freqs = calloc(nitems, sizeof(HuffNode_t));
-    if (freqs == NULL)
+    // Leaves, then the branches that join them.
+    struct HuffNode * nodes = calloc(2 * nitems - 1, sizeof(struct HuffNode));
+    if (nodes == NULL)
         goto fail;
 
-    struct BitEncoding * encoding = calloc(nitems, sizeof(struct BitEncoding));
-    if (encoding == NULL)
+    struct HuffCode * codes = calloc(nitems, sizeof(struct HuffCode));
+    if (codes == NULL)
         goto fail;
 
     // Set up the frequencies table.  This will inform the tree.
     for (int i = 0; i < nitems; i++) {
-        freqs[i].header.isLeaf = 1;
-        freqs[i].header.value = 0;
-        freqs[i].leaf.key = i;
+        nodes[i].left = nodes[i].right = -1;
+        nodes[i].key = i;
     }
 
     // Count each nybble or byte.
-    for (int i = 0; i < srcSize; i++) {
-        if (bitDepth == 8) {
-            freqs[src[i]].header.value++;
-        } else {
-            freqs[src[i] >> 4].header.value++;
-            freqs[src[i] & 0xF].header.value++;
+    if (bitDepth == 8) {
+        for (int i = 0; i < srcSize; i++)
+            nodes[src[i]].value++;
+    } else {
+        for (int i = 0; i < srcSize; i++) {
+            nodes[src[i] >> 4].value++;
+            nodes[src[i] & 0xF].value++;
         }
     }
 
 #ifdef DEBUG
     for (int i = 0; i < nitems; i++) {
-        fprintf(stderr, "%d: %d\n", i, freqs[i].header.value);
+        fprintf(stderr, "%d: %u\n", i, nodes[i].value);
     }
 #endif // DEBUG
 
-    // Sort the frequency table.
-    if (!msort(freqs, nitems, sizeof(HuffNode_t), cmp_tree))
-        goto fail;
+    // Sort the frequency table and prune zero-frequency values.
+    qsort(nodes, nitems, sizeof(struct HuffNode), cmp_leaves);
 
-    // Prune zero-frequency values.
-    for (int i = 0; i < nitems; i++) {
-        if (freqs[i].header.value != 0) {
-            if (i > 0) {
-                for (int j = i; j < nitems; j++) {
-                    freqs[j - i] = freqs[j];
-                }
-                nitems -= i;
-            }
-            break;
-        }
-        // This should never happen:
-        if (i == nitems - 1)
-            goto fail;
-    }
+    int numUnused = 0;
+    while (nodes[numUnused].value == 0)
+        numUnused++;
 
-    HuffNode_t * tree = calloc(nitems * 2 - 1, sizeof(HuffNode_t));
-    if (tree == NULL)
-        goto fail;
+    nitems -= numUnused;
+    memmove(nodes, nodes + numUnused, nitems * sizeof(struct HuffNode));
 
-    // Iteratively collapse the two least frequent nodes.
-    HuffNode_t * endptr = freqs + nitems - 2;
-
-    for (int i = 0; i < nitems - 1; i++) {
-        HuffNode_t * left = freqs;
-        HuffNode_t * right = freqs + 1;
-        tree[i * 2] = *right;
-        tree[i * 2 + 1] = *left;
-        for (int j = 0; j < nitems - i - 2; j++)
-            freqs[j] = freqs[j + 2];
-        endptr->header.isLeaf = 0;
-        endptr->header.value = tree[i * 2].header.value + tree[i * 2 + 1].header.value;
-        endptr->branch.left = tree + i * 2;
-        endptr->branch.right = tree + i * 2 + 1;
-        endptr--;
-        if (i < nitems - 2 && !msort(freqs, nitems - i - 1, sizeof(HuffNode_t), cmp_tree))
-            goto fail;
-    }
+    int root = build_tree(nodes, nitems);
+
+    // Write the tree breadth-first, and create the code table.
+    write_tree(dest, nodes, root, nitems, codes);
 
-    // Write the tree breadth-first, and create the path lookup table.
-    write_tree(dest, freqs, nitems, encoding);
+    free(nodes);
 
-    free(tree);
-    free(freqs);
+    // Encode the data itself. It's read as 32-bit words, so a partial
+    // last word is padded with zeros.
+    struct BitWriter writer = { dest, 4 + nitems * 2, 0, 0 };
+    int paddedSize = (srcSize + 3) & ~3;
 
-    // Encode the data itself.
-    int destPos = 4 + nitems * 2;
-    uint32_t destBuf = 0;
-    uint32_t srcBuf = 0;
-    int destBitPos = 0;
+    for (int srcPos = 0; srcPos < paddedSize; srcPos++) {
+        unsigned char value = srcPos < srcSize ? src[srcPos] : 0;
 
-    for (int srcPos = 0; srcPos < srcSize;) {
-        read_32_le(src, &srcPos, &srcBuf);
-        for (int i = 0; i < 32 / bitDepth; i++) {
-            write_bits(dest, &destPos, encoding, srcBuf & (0xFF >> (8 - bitDepth)), &destBuf, &destBitPos);
-            srcBuf >>= bitDepth;
+        if (bitDepth == 8) {
+            write_bits(&writer, codes[value].bits, codes[value].length);
+        } else {
+            write_bits(&writer, codes[value & 0xF].bits, codes[value & 0xF].length);
+            write_bits(&writer, codes[value >> 4].bits, codes[value >> 4].length);
         }
     }
 
-    if (destBitPos != 0) {
-        write_32_le(dest, &destPos, &destBuf, &destBitPos);
-    }
+    if (writer.numBits != 0)
+        write_last_word(&writer);
 
-    free(encoding);
+    free(codes);
 
     // Write the header.
     dest[0] = bitDepth | 0x20;
     dest[1] = srcSize;
     dest[2] = srcSize >> 8;
     dest[3] = srcSize >> 16;
-    *compressedSize_p = (destPos + 3) & ~3;
+    *compressedSize_p = (writer.destPos + 3) & ~3;
     return dest;
 
 fail:
     FATAL_ERROR("Fatal error while compressing Huff file.\n");
 }
 
+#define LOOKUP_BITS 8
+
+/*
+ * Decoding looks up the next LOOKUP_BITS bits of the stream in a table
+ * holding all the symbols they finish. If they don't finish any, the table
+ * gives the tree position they lead to, and the rest of the code is walked
+ * one bit at a time.
+ */
+struct HuffLookup {
+    unsigned char numSymbols;
+    unsigned char numBits;
+    int treePos;
+    unsigned char symbols[LOOKUP_BITS];
+};
+
+#define TREE_BRANCH -1
+#define TREE_INVALID -2
+
+// Follows one bit from the tree node at treePos, as the GBA BIOS does.
+// Returns the symbol if that reaches a leaf, TREE_BRANCH if it doesn't, or
+// TREE_INVALID if the tree points outside the data.
+static inline int step_tree(unsigned char * src, int srcSize, int * treePos, int bit) {
+    if (*treePos >= srcSize)
+        return TREE_INVALID;
+
+    unsigned char treeView = src[*treePos];
+    bool isLeaf = ((treeView << bit) & 0x80) != 0;
+
+    *treePos &= ~1; // align
+    *treePos += ((treeView & 0x3F) + 1) * 2 + bit;
+
+    if (!isLeaf)
+        return TREE_BRANCH;
+
+    if (*treePos >= srcSize)
+        return TREE_INVALID;
+
+    int symbol = src[*treePos];
+    *treePos = 5;
+    return symbol;
+}
+
+static void build_lookup(unsigned char * src, int srcSize, struct HuffLookup * lookup) {
+    for (int i = 0; i < 1 << LOOKUP_BITS; i++) {
+        struct HuffLookup * entry = &lookup[i];
+        int treePos = 5;
+
+        entry->numSymbols = 0;
+        entry->numBits = 0;
+        entry->treePos = 5;
+
+        for (int j = 0; j < LOOKUP_BITS; j++) {
+            int bit = (i >> (LOOKUP_BITS - 1 - j)) & 1;
+            int symbol = step_tree(src, srcSize, &treePos, bit);
+
+            if (symbol == TREE_INVALID) {
+                // Leave these bits to the bit-by-bit decoder, which only
+                // fails if the data really uses them.
+                entry->numSymbols = 0;
+                entry->numBits = 0;
+                break;
+            }
+
+            if (symbol != TREE_BRANCH) {
+                entry->symbols[entry->numSymbols++] = symbol;
+                entry->numBits = j + 1;
+            } else if (entry->numSymbols == 0 && j == LOOKUP_BITS - 1) {
+                entry->numBits = LOOKUP_BITS;
+                entry->treePos = treePos;
+            }
+        }
+    }
+}
+
 unsigned char * HuffDecompress(unsigned char * src, int srcSize, int * uncompressedSize_p) {
-    if (srcSize < 4)
+    if (srcSize < 5)
         goto fail;
 
     int bitDepth = *src & 15;
@@ -352,47 +349,75 @@ unsigned char * HuffDecompress(unsigned char * src, int srcSize, int * uncompres
 
     int destSize = (src[3] << 16) | (src[2] << 8) | src[1];
 
-    unsigned char *dest = malloc(destSize);
+    unsigned char *dest = calloc(destSize + 4, 1);
 
     if (dest == NULL)
         goto fail;
 
-    int treePos = 5;
+    struct HuffLookup lookup[1 << LOOKUP_BITS];
+    build_lookup(src, srcSize, lookup);
+
     int treeSize = (src[4] + 1) * 2;
     int srcPos = 4 + treeSize;
-    int destPos = 0;
-    int curValPos = 0;
-    uint32_t destTmp = 0;
-    uint32_t window;
-
-    for (;;)
-    {
-        if (srcPos >= srcSize)
-            goto fail;
-        read_32_le(src, &srcPos, &window);
-        for (int i = 0; i < 32; i++) {
-            int curBit = (window >> 31) & 1;
-            unsigned char treeView = src[treePos];
-            bool isLeaf = ((treeView << curBit) & 0x80) != 0;
-            treePos &= ~1; // align
-            treePos += ((treeView & 0x3F) + 1) * 2 + curBit;
-            if (isLeaf) {
-                destTmp >>= bitDepth;
-                destTmp |= (src[treePos] << (32 - bitDepth));
-                curValPos++;
-                if (curValPos == 32 / bitDepth) {
-                    write_32_le(dest, &destPos, &destTmp, &curValPos);
-                    if (destPos == destSize) {
-                        *uncompressedSize_p = destSize;
-                        return dest;
-                    }
-                }
-                treePos = 5;
+    int numSymbols = destSize * 8 / bitDepth;
+    int symbolIndex = 0;
+    // Unread bits, most significant first.
+    uint64_t window = 0;
+    int windowBits = 0;
+    int treePos = 5;
+
+    while (symbolIndex < numSymbols) {
+        if (windowBits <= 32 && srcPos < srcSize) {
+            window |= (uint64_t)read_32_le(src, srcPos, srcSize) << (32 - windowBits);
+            windowBits += 32;
+            srcPos += 4;
+        }
+
+        int numDecoded = 0;
+
+        struct HuffLookup * entry = &lookup[window >> (64 - LOOKUP_BITS)];
+
+        if (treePos == 5 && windowBits >= LOOKUP_BITS && entry->numBits != 0) {
+            for (int i = 0; i < entry->numSymbols && symbolIndex + numDecoded < numSymbols; i++) {
+                unsigned char symbol = entry->symbols[i];
+                if (bitDepth == 8)
+                    dest[symbolIndex + numDecoded] = symbol;
+                else
+                    dest[(symbolIndex + numDecoded) >> 1] |= (symbol & 0xF) << (((symbolIndex + numDecoded) & 1) * 4);
+                numDecoded++;
             }
+
+            window <<= entry->numBits;
+            windowBits -= entry->numBits;
+            treePos = entry->treePos;
+        } else if (windowBits > 0) {
+            int bit = window >> 63;
+
             window <<= 1;
+            windowBits--;
+
+            int symbol = step_tree(src, srcSize, &treePos, bit);
+
+            if (symbol == TREE_INVALID)
+                goto fail;
+
+            if (symbol != TREE_BRANCH) {
+                if (bitDepth == 8)
+                    dest[symbolIndex] = symbol;
+                else
+                    dest[symbolIndex >> 1] |= (symbol & 0xF) << ((symbolIndex & 1) * 4);
+                numDecoded = 1;
+            }
+        } else {
+            goto fail;
         }
+
+        symbolIndex += numDecoded;
     }
 
+    *uncompressedSize_p = destSize;
+    return dest;
+
 fail:
     FATAL_ERROR("Fatal error while decompressing Huff file.\n");
 }
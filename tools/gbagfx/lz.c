@@ -69,7 +69,211 @@ fail:
 	FATAL_ERROR("Fatal error while decompressing LZ file.\n");
 }
 
-unsigned char *LZCompress(unsigned char *src, int srcSize, int *compressedSize, const int minDistance)
+#define LZ_MIN_BLOCK_SIZE 3
+#define LZ_MAX_BLOCK_SIZE 18
+#define LZ_MAX_DISTANCE 0x1000
+#define LZ_HASH_BITS 15
+
+// Hash chains over the sliding window. Every position whose first three bytes
+// hash to the same bucket is linked from the most recent to the oldest, so a
+// chain walk visits candidates in order of increasing distance.
+struct LZMatchFinder {
+	int head[1 << LZ_HASH_BITS];
+	int *prev;
+};
+
+static unsigned int LZHash(const unsigned char *p)
+{
+	unsigned int key = (p[0] << 16) | (p[1] << 8) | p[2];
+	return (key * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+static struct LZMatchFinder *LZCreateMatchFinder(int srcSize)
+{
+	struct LZMatchFinder *finder = malloc(sizeof(struct LZMatchFinder));
+
+	if (finder == NULL)
+		return NULL;
+
+	finder->prev = malloc(srcSize * sizeof(int));
+
+	if (finder->prev == NULL) {
+		free(finder);
+		return NULL;
+	}
+
+	for (int i = 0; i < (1 << LZ_HASH_BITS); i++)
+		finder->head[i] = -1;
+
+	return finder;
+}
+
+static void LZFreeMatchFinder(struct LZMatchFinder *finder)
+{
+	free(finder->prev);
+	free(finder);
+}
+
+static void LZInsertPosition(struct LZMatchFinder *finder, unsigned char *src, int srcSize, int pos)
+{
+	if (pos + LZ_MIN_BLOCK_SIZE > srcSize)
+		return;
+
+	unsigned int hash = LZHash(&src[pos]);
+	finder->prev[pos] = finder->head[hash];
+	finder->head[hash] = pos;
+}
+
+// Finds the longest match for the data at srcPos. Ties are broken in favor of
+// the smallest distance, which is what the original brute-force search did,
+// so greedy parsing still produces byte-identical output.
+// All positions before srcPos must already have been inserted.
+static int LZFindMatch(struct LZMatchFinder *finder, unsigned char *src, int srcSize, int srcPos, int minDistance, int *bestBlockDistance)
+{
+	int maxBlockSize = srcSize - srcPos;
+
+	if (maxBlockSize > LZ_MAX_BLOCK_SIZE)
+		maxBlockSize = LZ_MAX_BLOCK_SIZE;
+
+	if (maxBlockSize < LZ_MIN_BLOCK_SIZE)
+		return 0;
+
+	int bestBlockSize = 0;
+	int blockStart = finder->head[LZHash(&src[srcPos])];
+
+	while (blockStart >= 0) {
+		int blockDistance = srcPos - blockStart;
+
+		if (blockDistance > LZ_MAX_DISTANCE)
+			break;
+
+		if (blockDistance >= minDistance) {
+			int blockSize = 0;
+
+			while (blockSize < maxBlockSize && src[blockStart + blockSize] == src[srcPos + blockSize])
+				blockSize++;
+
+			if (blockSize > bestBlockSize) {
+				*bestBlockDistance = blockDistance;
+				bestBlockSize = blockSize;
+
+				if (blockSize == maxBlockSize)
+					break;
+			}
+		}
+
+		blockStart = finder->prev[blockStart];
+	}
+
+	return bestBlockSize;
+}
+
+struct LZWriter {
+	unsigned char *dest;
+	int destPos;
+	int flagsPos;
+	int numTokens;
+};
+
+static void LZBeginToken(struct LZWriter *writer)
+{
+	if (writer->numTokens % 8 == 0) {
+		writer->flagsPos = writer->destPos++;
+		writer->dest[writer->flagsPos] = 0;
+	}
+}
+
+static void LZWriteLiteral(struct LZWriter *writer, unsigned char value)
+{
+	LZBeginToken(writer);
+	writer->dest[writer->destPos++] = value;
+	writer->numTokens++;
+}
+
+static void LZWriteBlock(struct LZWriter *writer, int blockSize, int blockDistance)
+{
+	LZBeginToken(writer);
+	writer->dest[writer->flagsPos] |= (0x80 >> (writer->numTokens % 8));
+	blockSize -= 3;
+	blockDistance--;
+	writer->dest[writer->destPos++] = (blockSize << 4) | ((unsigned int)blockDistance >> 8);
+	writer->dest[writer->destPos++] = (unsigned char)blockDistance;
+	writer->numTokens++;
+}
+
+// Chooses the parse with the fewest output bits. Every token costs one flag
+// bit plus either 8 bits for a literal or 16 bits for a block, and any block
+// can be shortened without changing its distance, so a backwards pass over
+// the longest match at each position is enough to find the optimum.
+static bool LZParseOptimal(struct LZMatchFinder *finder, unsigned char *src, int srcSize, int minDistance, struct LZWriter *writer)
+{
+	int *matchSize = malloc(srcSize * sizeof(int));
+	int *matchDistance = malloc(srcSize * sizeof(int));
+	int *cost = malloc((srcSize + 1) * sizeof(int));
+	int *choice = malloc(srcSize * sizeof(int));
+
+	if (matchSize == NULL || matchDistance == NULL || cost == NULL || choice == NULL) {
+		free(matchSize);
+		free(matchDistance);
+		free(cost);
+		free(choice);
+		return false;
+	}
+
+	for (int srcPos = 0; srcPos < srcSize; srcPos++) {
+		matchSize[srcPos] = LZFindMatch(finder, src, srcSize, srcPos, minDistance, &matchDistance[srcPos]);
+		LZInsertPosition(finder, src, srcSize, srcPos);
+	}
+
+	cost[srcSize] = 0;
+
+	for (int srcPos = srcSize - 1; srcPos >= 0; srcPos--) {
+		cost[srcPos] = 9 + cost[srcPos + 1];
+		choice[srcPos] = 1;
+
+		for (int blockSize = LZ_MIN_BLOCK_SIZE; blockSize <= matchSize[srcPos]; blockSize++) {
+			if (17 + cost[srcPos + blockSize] < cost[srcPos]) {
+				cost[srcPos] = 17 + cost[srcPos + blockSize];
+				choice[srcPos] = blockSize;
+			}
+		}
+	}
+
+	for (int srcPos = 0; srcPos < srcSize; srcPos += choice[srcPos]) {
+		if (choice[srcPos] >= LZ_MIN_BLOCK_SIZE)
+			LZWriteBlock(writer, choice[srcPos], matchDistance[srcPos]);
+		else
+			LZWriteLiteral(writer, src[srcPos]);
+	}
+
+	free(matchSize);
+	free(matchDistance);
+	free(cost);
+	free(choice);
+	return true;
+}
+
+static void LZParseGreedy(struct LZMatchFinder *finder, unsigned char *src, int srcSize, int minDistance, struct LZWriter *writer)
+{
+	int srcPos = 0;
+
+	while (srcPos < srcSize) {
+		int blockDistance = 0;
+		int blockSize = LZFindMatch(finder, src, srcSize, srcPos, minDistance, &blockDistance);
+
+		if (blockSize >= LZ_MIN_BLOCK_SIZE) {
+			LZWriteBlock(writer, blockSize, blockDistance);
+		} else {
+			LZWriteLiteral(writer, src[srcPos]);
+			blockSize = 1;
+		}
+
+		for (int i = 0; i < blockSize; i++)
+			LZInsertPosition(finder, src, srcSize, srcPos++);
+	}
+}
+
+unsigned char *LZCompress(unsigned char *src, int srcSize, int *compressedSize, const int minDistance, const bool optimal)
 {
 	if (srcSize <= 0)
 		goto fail;
@@ -84,69 +288,34 @@ unsigned char *LZCompress(unsigned char *src, int srcSize, int *compressedSize,
 	if (dest == NULL)
 		goto fail;
 
+	struct LZMatchFinder *finder = LZCreateMatchFinder(srcSize);
+
+	if (finder == NULL)
+		goto fail;
+
 	// header
 	dest[0] = 0x10; // LZ compression type
 	dest[1] = (unsigned char)srcSize;
 	dest[2] = (unsigned char)(srcSize >> 8);
 	dest[3] = (unsigned char)(srcSize >> 16);
 
-	int srcPos = 0;
-	int destPos = 4;
-
-	for (;;) {
-		unsigned char *flags = &dest[destPos++];
-		*flags = 0;
-
-		for (int i = 0; i < 8; i++) {
-			int bestBlockDistance = 0;
-			int bestBlockSize = 0;
-			int blockDistance = minDistance;
-
-			while (blockDistance <= srcPos && blockDistance <= 0x1000) {
-				int blockStart = srcPos - blockDistance;
-				int blockSize = 0;
-
-				while (blockSize < 18
-				    && srcPos + blockSize < srcSize
-				    && src[blockStart + blockSize] == src[srcPos + blockSize])
-					blockSize++;
-
-				if (blockSize > bestBlockSize) {
-					bestBlockDistance = blockDistance;
-					bestBlockSize = blockSize;
-
-					if (blockSize == 18)
-						break;
-				}
-
-				blockDistance++;
-			}
+	struct LZWriter writer = { dest, 4, 0, 0 };
 
-			if (bestBlockSize >= 3) {
-				*flags |= (0x80 >> i);
-				srcPos += bestBlockSize;
-				bestBlockSize -= 3;
-				bestBlockDistance--;
-				dest[destPos++] = (bestBlockSize << 4) | ((unsigned int)bestBlockDistance >> 8);
-				dest[destPos++] = (unsigned char)bestBlockDistance;
-			} else {
-				dest[destPos++] = src[srcPos++];
-			}
+	if (optimal) {
+		if (!LZParseOptimal(finder, src, srcSize, minDistance, &writer))
+			goto fail;
+	} else {
+		LZParseGreedy(finder, src, srcSize, minDistance, &writer);
+	}
 
-			if (srcPos == srcSize) {
-				// Pad to multiple of 4 bytes.
-				int remainder = destPos % 4;
+	LZFreeMatchFinder(finder);
 
-				if (remainder != 0) {
-					for (int i = 0; i < 4 - remainder; i++)
-						dest[destPos++] = 0;
-				}
+	// Pad to multiple of 4 bytes.
+	while (writer.destPos % 4 != 0)
+		dest[writer.destPos++] = 0;
 
-				*compressedSize = destPos;
-				return dest;
-			}
-		}
-	}
+	*compressedSize = writer.destPos;
+	return dest;
 
 fail:
 	FATAL_ERROR("Fatal error while compressing LZ file.\n");
@@ -3,7 +3,9 @@
 #ifndef LZ_H
 #define LZ_H
 
+#include <stdbool.h>
+
 unsigned char *LZDecompress(unsigned char *src, int srcSize, int *uncompressedSize);
-unsigned char *LZCompress(unsigned char *src, int srcSize, int *compressedSize, const int minDistance);
+unsigned char *LZCompress(unsigned char *src, int srcSize, int *compressedSize, const int minDistance, const bool optimal);
 
 #endif // LZ_H
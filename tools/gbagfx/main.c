@@ -13,6 +13,8 @@
 #include "rl.h"
 #include "font.h"
 #include "huff.h"
+#include "batch.h"
+#include "toolcache.h"
 
 struct CommandHandler
 {
@@ -63,7 +65,9 @@ void ConvertGbaToPng(char *inputPath, char *outputPath, struct GbaToPngOptions *
 
     image.hasTransparency = options->hasTransparency;
 
-    WritePng(outputPath, &image);
+    struct PngCompression compression = { options->compressionLevel, options->compressionStrategy };
+
+    WritePng(outputPath, &image, &compression);
 
     FreeImage(&image);
 }
@@ -94,6 +98,8 @@ void HandleGbaToPngCommand(char *inputPath, char *outputPath, int argc, char **a
     options.metatileHeight = 1;
     options.tilemapFilePath = NULL;
     options.isAffineMap = false;
+    options.compressionLevel = Z_BEST_SPEED;
+    options.compressionStrategy = Z_DEFAULT_STRATEGY;
 
     for (int i = 3; i < argc; i++)
     {
@@ -162,6 +168,39 @@ void HandleGbaToPngCommand(char *inputPath, char *outputPath, int argc, char **a
         {
             options.isAffineMap = true;
         }
+        else if (strcmp(option, "-compression") == 0)
+        {
+            if (i + 1 >= argc)
+                FATAL_ERROR("No compression level following \"-compression\".\n");
+
+            i++;
+
+            if (!ParseNumber(argv[i], NULL, 10, &options.compressionLevel))
+                FATAL_ERROR("Failed to parse compression level.\n");
+
+            if (options.compressionLevel < 0 || options.compressionLevel > 9)
+                FATAL_ERROR("Compression level must be between 0 and 9.\n");
+        }
+        else if (strcmp(option, "-strategy") == 0)
+        {
+            if (i + 1 >= argc)
+                FATAL_ERROR("No compression strategy following \"-strategy\".\n");
+
+            i++;
+
+            if (strcmp(argv[i], "default") == 0)
+                options.compressionStrategy = Z_DEFAULT_STRATEGY;
+            else if (strcmp(argv[i], "filtered") == 0)
+                options.compressionStrategy = Z_FILTERED;
+            else if (strcmp(argv[i], "huffman") == 0)
+                options.compressionStrategy = Z_HUFFMAN_ONLY;
+            else if (strcmp(argv[i], "rle") == 0)
+                options.compressionStrategy = Z_RLE;
+            else if (strcmp(argv[i], "fixed") == 0)
+                options.compressionStrategy = Z_FIXED;
+            else
+                FATAL_ERROR("Unrecognized compression strategy \"%s\".\n", argv[i]);
+        }
         else
         {
             FATAL_ERROR("Unrecognized option \"%s\".\n", option);
@@ -304,8 +343,10 @@ void HandleLatinFontToPngCommand(char *inputPath, char *outputPath, int argc UNU
     struct Image image;
     image.tilemap.data.affine = NULL; // initialize to NULL to avoid issues in FreeImage
 
+    struct PngCompression compression = PNG_COMPRESSION_FAST;
+
     ReadLatinFont(inputPath, &image);
-    WritePng(outputPath, &image);
+    WritePng(outputPath, &image, &compression);
 
     FreeImage(&image);
 }
@@ -328,8 +369,10 @@ void HandleHalfwidthJapaneseFontToPngCommand(char *inputPath, char *outputPath,
     struct Image image;
     image.tilemap.data.affine = NULL; // initialize to NULL to avoid issues in FreeImage
 
+    struct PngCompression compression = PNG_COMPRESSION_FAST;
+
     ReadHalfwidthJapaneseFont(inputPath, &image);
-    WritePng(outputPath, &image);
+    WritePng(outputPath, &image, &compression);
 
     FreeImage(&image);
 }
@@ -352,8 +395,10 @@ void HandleFullwidthJapaneseFontToPngCommand(char *inputPath, char *outputPath,
     struct Image image;
     image.tilemap.data.affine = NULL; // initialize to NULL to avoid issues in FreeImage
 
+    struct PngCompression compression = PNG_COMPRESSION_FAST;
+
     ReadFullwidthJapaneseFont(inputPath, &image);
-    WritePng(outputPath, &image);
+    WritePng(outputPath, &image, &compression);
 
     FreeImage(&image);
 }
@@ -375,6 +420,7 @@ void HandleLZCompressCommand(char *inputPath, char *outputPath, int argc, char *
 {
     int overflowSize = 0;
     int minDistance = 2; // default, for compatibility with LZ77UnCompVram()
+    bool optimal = false;
 
     for (int i = 3; i < argc; i++)
     {
@@ -406,6 +452,11 @@ void HandleLZCompressCommand(char *inputPath, char *outputPath, int argc, char *
             if (minDistance < 1)
                 FATAL_ERROR("LZ min search distance must be positive.\n");
         }
+        else if (strcmp(option, "-optimal") == 0)
+        {
+            // Produces smaller output, but it won't match the original files.
+            optimal = true;
+        }
         else
         {
             FATAL_ERROR("Unrecognized option \"%s\".\n", option);
@@ -422,7 +473,7 @@ void HandleLZCompressCommand(char *inputPath, char *outputPath, int argc, char *
     unsigned char *buffer = ReadWholeFileZeroPadded(inputPath, &fileSize, overflowSize);
 
     int compressedSize;
-    unsigned char *compressedData = LZCompress(buffer, fileSize + overflowSize, &compressedSize, minDistance);
+    unsigned char *compressedData = LZCompress(buffer, fileSize + overflowSize, &compressedSize, minDistance, optimal);
 
     compressedData[1] = (unsigned char)fileSize;
     compressedData[2] = (unsigned char)(fileSize >> 8);
@@ -535,40 +586,52 @@ void HandleHuffDecompressCommand(char *inputPath, char *outputPath, int argc UNU
     free(uncompressedData);
 }
 
-int main(int argc, char **argv)
+static const struct CommandHandler handlers[] =
+{
+    { "1bpp", "png", HandleGbaToPngCommand },
+    { "4bpp", "png", HandleGbaToPngCommand },
+    { "8bpp", "png", HandleGbaToPngCommand },
+    { "png", "1bpp", HandlePngToGbaCommand },
+    { "png", "4bpp", HandlePngToGbaCommand },
+    { "png", "8bpp", HandlePngToGbaCommand },
+    { "png", "gbapal", HandlePngToGbaPaletteCommand },
+    { "png", "pal", HandlePngToJascPaletteCommand },
+    { "gbapal", "pal", HandleGbaToJascPaletteCommand },
+    { "pal", "gbapal", HandleJascToGbaPaletteCommand },
+    { "latfont", "png", HandleLatinFontToPngCommand },
+    { "png", "latfont", HandlePngToLatinFontCommand },
+    { "hwjpnfont", "png", HandleHalfwidthJapaneseFontToPngCommand },
+    { "png", "hwjpnfont", HandlePngToHalfwidthJapaneseFontCommand },
+    { "fwjpnfont", "png", HandleFullwidthJapaneseFontToPngCommand },
+    { "png", "fwjpnfont", HandlePngToFullwidthJapaneseFontCommand },
+    { NULL, "huff", HandleHuffCompressCommand },
+    { NULL, "lz", HandleLZCompressCommand },
+    { "huff", NULL, HandleHuffDecompressCommand },
+    { "lz", NULL, HandleLZDecompressCommand },
+    { NULL, "rl", HandleRLCompressCommand },
+    { "rl", NULL, HandleRLDecompressCommand },
+    { NULL, NULL, NULL }
+};
+
+// Adds the files named by options, such as "-palette", to the cache key.
+static void AddOptionInputs(struct ToolCache *cache, int argc, char **argv)
+{
+    for (int i = 3; i < argc - 1; i++)
+    {
+        if (strcmp(argv[i], "-palette") == 0 || strcmp(argv[i], "-tilemap") == 0)
+            ToolCacheAddInput(cache, argv[++i]);
+    }
+}
+
+// argv has the same layout as the command line: argv[1] is the input path,
+// argv[2] is the output path and any options follow. cache may be NULL.
+void ConvertFile(int argc, char **argv, struct ToolCache *cache)
 {
     char converted = 0;
 
     if (argc < 3)
         FATAL_ERROR("Usage: gbagfx INPUT_PATH OUTPUT_PATH [options...]\n");
 
-    struct CommandHandler handlers[] =
-    {
-        { "1bpp", "png", HandleGbaToPngCommand },
-        { "4bpp", "png", HandleGbaToPngCommand },
-        { "8bpp", "png", HandleGbaToPngCommand },
-        { "png", "1bpp", HandlePngToGbaCommand },
-        { "png", "4bpp", HandlePngToGbaCommand },
-        { "png", "8bpp", HandlePngToGbaCommand },
-        { "png", "gbapal", HandlePngToGbaPaletteCommand },
-        { "png", "pal", HandlePngToJascPaletteCommand },
-        { "gbapal", "pal", HandleGbaToJascPaletteCommand },
-        { "pal", "gbapal", HandleJascToGbaPaletteCommand },
-        { "latfont", "png", HandleLatinFontToPngCommand },
-        { "png", "latfont", HandlePngToLatinFontCommand },
-        { "hwjpnfont", "png", HandleHalfwidthJapaneseFontToPngCommand },
-        { "png", "hwjpnfont", HandlePngToHalfwidthJapaneseFontCommand },
-        { "fwjpnfont", "png", HandleFullwidthJapaneseFontToPngCommand },
-        { "png", "fwjpnfont", HandlePngToFullwidthJapaneseFontCommand },
-        { NULL, "huff", HandleHuffCompressCommand },
-        { NULL, "lz", HandleLZCompressCommand },
-        { "huff", NULL, HandleHuffDecompressCommand },
-        { "lz", NULL, HandleLZDecompressCommand },
-        { NULL, "rl", HandleRLCompressCommand },
-        { "rl", NULL, HandleRLDecompressCommand },
-        { NULL, NULL, NULL }
-    };
-
     char *inputPath = argv[1];
     char *outputPath = argv[2];
     char *inputFileExtension = GetFileExtensionAfterDot(inputPath);
@@ -610,7 +673,21 @@ int main(int argc, char **argv)
         if ((handlers[i].inputFileExtension == NULL || strcmp(handlers[i].inputFileExtension, inputFileExtension) == 0)
             && (handlers[i].outputFileExtension == NULL || strcmp(handlers[i].outputFileExtension, outputFileExtension) == 0))
         {
-            handlers[i].function(inputPath, outputPath, argc, argv);
+            if (cache == NULL)
+            {
+                handlers[i].function(inputPath, outputPath, argc, argv);
+            }
+            else
+            {
+                ToolCacheAddInput(cache, inputPath);
+                AddOptionInputs(cache, argc, argv);
+
+                if (!ToolCacheRestore(cache))
+                    handlers[i].function(inputPath, (char *)ToolCacheAddOutput(cache, outputPath), argc, argv);
+
+                ToolCacheFinish(cache);
+            }
+
             converted = 1;
             break;
         }
@@ -621,6 +698,45 @@ int main(int argc, char **argv)
 
     if (!converted)
         FATAL_ERROR("Don't know how to convert \"%s\" to \"%s\".\n", argv[1], argv[2]);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc >= 2 && strcmp(argv[1], "--batch") == 0)
+    {
+        int numThreads = 0;
+
+        if (argc < 3)
+            FATAL_ERROR("Usage: gbagfx --batch MANIFEST_PATH [-j THREADS]\n");
+
+        for (int i = 3; i < argc; i++)
+        {
+            char *option = argv[i];
+
+            if (strcmp(option, "-j") == 0)
+            {
+                if (i + 1 >= argc)
+                    FATAL_ERROR("No number of threads following \"-j\".\n");
+
+                i++;
+
+                if (!ParseNumber(argv[i], NULL, 10, &numThreads))
+                    FATAL_ERROR("Failed to parse number of threads.\n");
+
+                if (numThreads < 1)
+                    FATAL_ERROR("Number of threads must be positive.\n");
+            }
+            else
+            {
+                FATAL_ERROR("Unrecognized option \"%s\".\n", option);
+            }
+        }
+
+        RunBatch(argv[2], numThreads);
+        return 0;
+    }
+
+    ConvertFile(argc, argv, ToolCacheBegin(argc, argv));
 
     return 0;
 }
@@ -14,6 +14,8 @@ struct GbaToPngOptions {
     int metatileHeight;
     char *tilemapFilePath;
     bool isAffineMap;
+    int compressionLevel;
+    int compressionStrategy;
 };
 
 struct PngToGbaOptions {
@@ -2,9 +2,77 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 #include "global.h"
 #include "rl.h"
 
+#define ONES  0x0101010101010101ULL
+#define HIGHS 0x8080808080808080ULL
+
+static inline uint64_t Load64(const unsigned char *p)
+{
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+    return word;
+}
+
+// True if any byte of word is zero.
+static inline bool HasZeroByte(uint64_t word)
+{
+    return ((word - ONES) & ~word & HIGHS) != 0;
+}
+
+// Returns the number of bytes from srcPos before the next run of three equal
+// bytes, or maxLength if there isn't one that soon.
+static int FindRun(unsigned char *src, int srcPos, int srcSize, int maxLength)
+{
+    int length = 0;
+
+    // Check eight starting positions at a time, and only look at them one by
+    // one once a word says one of them starts a run.
+    while (length + 8 <= maxLength && srcPos + length + 10 <= srcSize)
+    {
+        const unsigned char *p = src + srcPos + length;
+        uint64_t first = Load64(p);
+
+        if (HasZeroByte((first ^ Load64(p + 1)) | (first ^ Load64(p + 2))))
+            break;
+
+        length += 8;
+    }
+
+    while (length < maxLength && srcPos + length < srcSize)
+    {
+        int pos = srcPos + length;
+
+        if (pos + 2 < srcSize && src[pos] == src[pos + 1] && src[pos] == src[pos + 2])
+            break;
+
+        length++;
+    }
+
+    return length;
+}
+
+// Returns how many bytes from srcPos equal data, up to maxLength.
+static int GetRunLength(unsigned char *src, int srcPos, int srcSize, unsigned char data, int maxLength)
+{
+    uint64_t pattern = data * ONES;
+    int length = 0;
+
+    if (maxLength > srcSize - srcPos)
+        maxLength = srcSize - srcPos;
+
+    while (length + 8 <= maxLength && Load64(src + srcPos + length) == pattern)
+        length += 8;
+
+    while (length < maxLength && src[srcPos + length] == data)
+        length++;
+
+    return length;
+}
+
 unsigned char *RLDecompress(unsigned char *src, int srcSize, int *uncompressedSize)
 {
     if (srcSize < 4)
@@ -31,23 +99,23 @@ unsigned char *RLDecompress(unsigned char *src, int srcSize, int *uncompressedSi
         if (compressed)
         {
             int length = (flags & 0x7F) + 3;
-            unsigned char data = src[srcPos++];
 
-            if (destPos + length > destSize)
+            if (srcPos >= srcSize || destPos + length > destSize)
                 goto fail;
 
-            for (int i = 0; i < length; i++)
-                dest[destPos++] = data;
+            memset(dest + destPos, src[srcPos++], length);
+            destPos += length;
         }
         else
         {
             int length = (flags & 0x7F) + 1;
 
-            if (destPos + length > destSize)
+            if (srcPos + length > srcSize || destPos + length > destSize)
                 goto fail;
 
-            for (int i = 0; i < length; i++)
-                dest[destPos++] = src[srcPos++];
+            memcpy(dest + destPos, src + srcPos, length);
+            srcPos += length;
+            destPos += length;
         }
 
         if (destPos == destSize)
@@ -87,40 +155,21 @@ unsigned char *RLCompress(unsigned char *src, int srcSize, int *compressedSize)
 
     for (;;)
     {
-        bool compress = false;
-        int uncompressedStart = srcPos;
-        int uncompressedLength = 0;
-
-        while (srcPos < srcSize && uncompressedLength < (0x7F + 1))
-        {
-            compress = (srcPos + 2 < srcSize && src[srcPos] == src[srcPos + 1] && src[srcPos] == src[srcPos + 2]);
+        int uncompressedLength = FindRun(src, srcPos, srcSize, 0x7F + 1);
+        bool compress = (uncompressedLength < (0x7F + 1) && srcPos + uncompressedLength < srcSize);
 
-            if (compress)
-                break;
-
-            srcPos++;
-            uncompressedLength++;
-        }
-        
         if (uncompressedLength > 0)
         {
             dest[destPos++] = uncompressedLength - 1;
-
-            for (int i = 0; i < uncompressedLength; i++)
-                dest[destPos++] = src[uncompressedStart + i];
+            memcpy(dest + destPos, src + srcPos, uncompressedLength);
+            destPos += uncompressedLength;
+            srcPos += uncompressedLength;
         }
 
         if (compress)
         {
             unsigned char data = src[srcPos];
-            int compressedLength = 0;
-
-            while (compressedLength < (0x7F + 3)
-                && srcPos + compressedLength < srcSize
-                && src[srcPos + compressedLength] == data)
-            {
-                compressedLength++;
-            }
+            int compressedLength = GetRunLength(src, srcPos, srcSize, data, 0x7F + 3);
 
             dest[destPos++] = 0x80 | (compressedLength - 3);
             dest[destPos++] = data;
@@ -2834,7 +2834,7 @@ class Renderer {
         break;
     }
     try {
-      return &m_data->at(json::json_pointer(ptr.data()));
+      return &lookup(ptr);
     } catch (std::exception&) {
       // try to evaluate as a no-argument callback
       if (auto callback = m_callbacks.find_callback(bc.str, 0)) {
@@ -2864,6 +2864,38 @@ class Renderer {
     }
   }
 
+  // Loop levels only hold their own variables, so the first reference token
+  // picks the innermost level defining it, falling back to the render data.
+  const json& lookup(nonstd::string_view ptr) const {
+    nonstd::string_view token = ptr.substr(1, ptr.find('/', 1) - 1);
+    nonstd::string_view rest = ptr.substr(std::min(ptr.size(), token.size() + 1));
+    std::string key = static_cast<std::string>(token);
+    for (size_t pos = key.find('~'); pos != std::string::npos; pos = key.find('~', pos + 1)) {
+      if (pos + 1 < key.size() && (key[pos + 1] == '0' || key[pos + 1] == '1')) {
+        key.replace(pos, 2, key[pos + 1] == '0' ? "~" : "/");
+      }
+    }
+
+    for (auto level = m_loop_stack.rbegin(); level != m_loop_stack.rend(); ++level) {
+      auto it = level->data.find(key);
+      if (it != level->data.end()) {
+        return it->at(json::json_pointer(static_cast<std::string>(rest)));
+      }
+    }
+    return m_data->at(json::json_pointer(static_cast<std::string>(ptr)));
+  }
+
+  // The render data with the variables of all loops merged in.
+  json get_scoped_data() const {
+    json result = *m_data;
+    for (const auto& level : m_loop_stack) {
+      for (auto it = level.data.begin(); it != level.data.end(); ++it) {
+        result[it.key()] = it.value();
+      }
+    }
+    return result;
+  }
+
   void update_loop_data()  {
     LoopLevel& level = m_loop_stack.back();
 
@@ -3209,7 +3241,7 @@ class Renderer {
           break;
         }
         case Bytecode::Op::Include:
-          Renderer(m_included_templates, m_callbacks).render_to(os, m_included_templates.find(get_imm(bc)->get_ref<const std::string&>())->second, *m_data);
+          Renderer(m_included_templates, m_callbacks).render_to(os, m_included_templates.find(get_imm(bc)->get_ref<const std::string&>())->second, m_loop_stack.empty() ? *m_data : get_scoped_data());
           break;
         case Bytecode::Op::Callback: {
           auto callback = m_callbacks.find_callback(bc.str, bc.args);
@@ -3244,7 +3276,7 @@ class Renderer {
           LoopLevel& level = m_loop_stack.back();
           level.value_name = bc.str;
           level.values = std::move(m_stack.back());
-          level.data = (*m_data);
+          level.data = json::object();
           m_stack.pop_back();
 
           if (bc.value.is_string()) {
@@ -3275,14 +3307,25 @@ class Renderer {
           }
 
           // provide parent access in nested loop
-          auto parent_loop_it = level.data.find("loop");
-          if (parent_loop_it != level.data.end()) {
-            json loop_copy = *parent_loop_it;
-            (*parent_loop_it)["parent"] = std::move(loop_copy);
+          const json* parent_loop = nullptr;
+          for (auto outer = std::next(m_loop_stack.rbegin()); outer != m_loop_stack.rend() && !parent_loop; ++outer) {
+            auto it = outer->data.find("loop");
+            if (it != outer->data.end()) {
+              parent_loop = &*it;
+            }
+          }
+          if (!parent_loop) {
+            auto it = m_data->find("loop");
+            if (it != m_data->end()) {
+              parent_loop = &*it;
+            }
+          }
+          if (parent_loop) {
+            json& loop_data = level.data["loop"] = *parent_loop;
+            json loop_copy = loop_data;
+            loop_data["parent"] = std::move(loop_copy);
           }
 
-          // set "current" data to loop data
-          m_data = &level.data;
           update_loop_data();
           break;
         }
@@ -3303,12 +3346,6 @@ class Renderer {
 
           if (done) {
             m_loop_stack.pop_back();
-            // set "current" data to outer loop data or main data as appropriate
-            if (!m_loop_stack.empty()) {
-              m_data = &m_loop_stack.back().data;
-            } else {
-              m_data = &data;
-            }
             break;
           }
 
@@ -3495,6 +3532,12 @@ class Environment {
   void include_template(const std::string& name, const Template& tmpl) {
     m_impl->included_templates[name] = tmpl;
   }
+
+  /** Returns the templates loaded so far through include statements, by path.
+   */
+  const TemplateStorage& get_included_templates() const {
+    return m_impl->included_templates;
+  }
 };
 
 /*!
@@ -9,6 +9,8 @@ using std::string; using std::to_string;
 
 #include <inja.hpp>
 using namespace inja;
+
+#include "toolcache.h"
 using json = nlohmann::json;
 
 std::map<string, string> customVars;
@@ -23,19 +25,39 @@ string get_custom_var(string key)
     return customVars[key];
 }
 
+// Parsed templates and JSON files, so that each is only read once when
+// several outputs share them.
+std::map<string, Template> templates;
+std::map<string, json> jsonFiles;
+
+const Template& get_template(Environment& env, const string& filepath)
+{
+    auto it = templates.find(filepath);
+    if (it == templates.end())
+        it = templates.emplace(filepath, env.parse_template(filepath)).first;
+    return it->second;
+}
+
+const json& get_json(Environment& env, const string& filepath)
+{
+    auto it = jsonFiles.find(filepath);
+    if (it == jsonFiles.end())
+        it = jsonFiles.emplace(filepath, env.load_json(filepath)).first;
+    return it->second;
+}
+
 int main(int argc, char *argv[])
 {
-    if (argc != 4)
-        FATAL_ERROR("USAGE: jsonproc <json-filepath> <template-filepath> <output-filepath>\n");
+    if (argc < 4 || (argc - 1) % 3 != 0)
+        FATAL_ERROR("USAGE: jsonproc <json-filepath> <template-filepath> <output-filepath> [<json-filepath> <template-filepath> <output-filepath> ...]\n");
 
-    string jsonfilepath = argv[1];
-    string templateFilepath = argv[2];
-    string outputFilepath = argv[3];
+    string jsonfilepath;
+    string templateFilepath;
 
     Environment env;
 
     // Add custom command callbacks.
-    env.add_callback("doNotModifyHeader", 0, [jsonfilepath, templateFilepath](Arguments& args) {
+    env.add_callback("doNotModifyHeader", 0, [&jsonfilepath, &templateFilepath](Arguments& args) {
         return "//\n// DO NOT MODIFY THIS FILE! It is auto-generated from " + jsonfilepath +" and Inja template " + templateFilepath + "\n//\n";
     });
 
@@ -96,14 +118,41 @@ int main(int argc, char *argv[])
         return args.at(0)->empty();
     });
 
-    try
+    ToolCache* cache = ToolCacheBegin(argc, argv);
+
+    for (int i = 1; i < argc; i += 3)
     {
-        env.write_with_json_file(templateFilepath, jsonfilepath, outputFilepath);
+        ToolCacheAddInput(cache, argv[i]);
+        ToolCacheAddInput(cache, argv[i + 1]);
     }
-    catch (const std::exception& e)
+
+    if (!ToolCacheRestore(cache))
     {
-        FATAL_ERROR("JSONPROC_ERROR: %s\n", e.what());
+        // Each (json, template, output) triple is rendered as if by a separate run.
+        for (int i = 1; i < argc; i += 3)
+        {
+            jsonfilepath = argv[i];
+            templateFilepath = argv[i + 1];
+            string outputFilepath = ToolCacheAddOutput(cache, argv[i + 2]);
+
+            customVars.clear();
+
+            try
+            {
+                const json& data = get_json(env, jsonfilepath);
+                env.write(get_template(env, templateFilepath), data, outputFilepath);
+            }
+            catch (const std::exception& e)
+            {
+                FATAL_ERROR("JSONPROC_ERROR: %s\n", e.what());
+            }
+        }
+
+        for (const auto& included : env.get_included_templates())
+            ToolCacheAddInput(cache, included.first.c_str());
     }
 
+    ToolCacheFinish(cache);
+
     return 0;
 }
@@ -0,0 +1,481 @@
+// json.cpp
+
+#include <cstdlib>
+#include <cstdio>
+
+#include <string>
+using std::string;
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "json.h"
+#include "mapjson.h"
+
+static const int max_depth = 200;
+
+class JsonParser {
+public:
+    JsonParser(JsonDocument &doc) : doc(doc), str(doc.text), size(doc.size), i(0) {}
+
+    void parse_document() {
+        parse_value(0);
+        consume_whitespace();
+
+        if (i != size)
+            fail("unexpected trailing " + describe(i));
+    }
+
+private:
+    JsonDocument &doc;
+    const char *str;
+    size_t size;
+    size_t i;
+
+    char peek(size_t pos) const {
+        return pos < size ? str[pos] : 0;
+    }
+
+    string describe(size_t pos) const {
+        if (pos >= size)
+            return "end of input";
+
+        char buf[16];
+        unsigned char c = str[pos];
+
+        if (c >= 0x20 && c <= 0x7F)
+            std::snprintf(buf, sizeof(buf), "'%c' (%d)", c, c);
+        else
+            std::snprintf(buf, sizeof(buf), "(%d)", c);
+
+        return buf;
+    }
+
+    [[noreturn]] void fail(const string &msg) const {
+        FATAL_ERROR("%s: %s at offset %zu\n", doc.filepath.c_str(), msg.c_str(), i);
+    }
+
+    void consume_whitespace() {
+        while (i < size && (str[i] == ' ' || str[i] == '\r' || str[i] == '\n' || str[i] == '\t'))
+            i++;
+    }
+
+    uint32_t add_node(JsonType type) {
+        JsonDocument::Node node = {};
+        node.type = type;
+        node.str = "";
+        doc.nodes.push_back(node);
+        return doc.nodes.size() - 1;
+    }
+
+    void finish_node(uint32_t index) {
+        doc.nodes[index].end = doc.nodes.size();
+    }
+
+    static void encode_utf8(long pt, string &out) {
+        if (pt < 0)
+            return;
+
+        if (pt < 0x80) {
+            out += static_cast<char>(pt);
+        } else if (pt < 0x800) {
+            out += static_cast<char>((pt >> 6) | 0xC0);
+            out += static_cast<char>((pt & 0x3F) | 0x80);
+        } else if (pt < 0x10000) {
+            out += static_cast<char>((pt >> 12) | 0xE0);
+            out += static_cast<char>(((pt >> 6) & 0x3F) | 0x80);
+            out += static_cast<char>((pt & 0x3F) | 0x80);
+        } else {
+            out += static_cast<char>((pt >> 18) | 0xF0);
+            out += static_cast<char>(((pt >> 12) & 0x3F) | 0x80);
+            out += static_cast<char>(((pt >> 6) & 0x3F) | 0x80);
+            out += static_cast<char>((pt & 0x3F) | 0x80);
+        }
+    }
+
+    long parse_hex4() {
+        long value = 0;
+
+        for (int j = 0; j < 4; j++) {
+            char c = peek(i + j);
+            value <<= 4;
+
+            if (c >= '0' && c <= '9')
+                value |= c - '0';
+            else if (c >= 'a' && c <= 'f')
+                value |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F')
+                value |= c - 'A' + 10;
+            else
+                fail("bad \\u escape");
+        }
+
+        i += 4;
+        return value;
+    }
+
+    // Strings without escapes are left in place. The rest are decoded the
+    // way json11 does it, including surrogate pairs.
+    void parse_string(uint32_t index) {
+        i++; // Go past the opening quote.
+
+        size_t start = i;
+
+        while (i < size && str[i] != '"' && str[i] != '\\') {
+            if (static_cast<unsigned char>(str[i]) < 0x20)
+                fail("unescaped " + describe(i) + " in string");
+            i++;
+        }
+
+        if (i >= size)
+            fail("unexpected end of input in string");
+
+        if (str[i] == '"') {
+            doc.nodes[index].str = &str[start];
+            doc.nodes[index].length = i - start;
+            i++;
+            return;
+        }
+
+        string out(&str[start], i - start);
+        long last_escaped_codepoint = -1;
+
+        for (;;) {
+            if (i >= size)
+                fail("unexpected end of input in string");
+
+            char ch = str[i++];
+
+            if (ch == '"') {
+                encode_utf8(last_escaped_codepoint, out);
+                break;
+            }
+
+            if (static_cast<unsigned char>(ch) < 0x20)
+                fail("unescaped " + describe(i - 1) + " in string");
+
+            if (ch != '\\') {
+                encode_utf8(last_escaped_codepoint, out);
+                last_escaped_codepoint = -1;
+                out += ch;
+                continue;
+            }
+
+            if (i >= size)
+                fail("unexpected end of input in string");
+
+            ch = str[i++];
+
+            if (ch == 'u') {
+                long codepoint = parse_hex4();
+
+                if (last_escaped_codepoint >= 0xD800 && last_escaped_codepoint <= 0xDBFF
+                 && codepoint >= 0xDC00 && codepoint <= 0xDFFF) {
+                    encode_utf8((((last_escaped_codepoint - 0xD800) << 10)
+                                 | (codepoint - 0xDC00)) + 0x10000, out);
+                    last_escaped_codepoint = -1;
+                } else {
+                    encode_utf8(last_escaped_codepoint, out);
+                    last_escaped_codepoint = codepoint;
+                }
+                continue;
+            }
+
+            encode_utf8(last_escaped_codepoint, out);
+            last_escaped_codepoint = -1;
+
+            switch (ch) {
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case '"': case '\\': case '/': out += ch; break;
+            default:
+                fail("invalid escape character " + describe(i - 1));
+            }
+        }
+
+        doc.decoded_strings.push_back(std::move(out));
+        const string &decoded = doc.decoded_strings.back();
+        doc.nodes[index].str = decoded.data();
+        doc.nodes[index].length = decoded.size();
+    }
+
+    void parse_number(uint32_t index) {
+        size_t start = i;
+
+        if (peek(i) == '-')
+            i++;
+
+        if (peek(i) == '0') {
+            i++;
+            if (peek(i) >= '0' && peek(i) <= '9')
+                fail("leading 0s not permitted in numbers");
+        } else if (peek(i) >= '1' && peek(i) <= '9') {
+            while (peek(i) >= '0' && peek(i) <= '9')
+                i++;
+        } else {
+            fail("invalid " + describe(i) + " in number");
+        }
+
+        if (peek(i) == '.') {
+            i++;
+            if (!(peek(i) >= '0' && peek(i) <= '9'))
+                fail("at least one digit required in fractional part");
+            while (peek(i) >= '0' && peek(i) <= '9')
+                i++;
+        }
+
+        if (peek(i) == 'e' || peek(i) == 'E') {
+            i++;
+            if (peek(i) == '+' || peek(i) == '-')
+                i++;
+            if (!(peek(i) >= '0' && peek(i) <= '9'))
+                fail("at least one digit required in exponent");
+            while (peek(i) >= '0' && peek(i) <= '9')
+                i++;
+        }
+
+        string number(&str[start], i - start);
+        doc.nodes[index].int_value = static_cast<int>(std::strtod(number.c_str(), nullptr));
+    }
+
+    void expect(const char *literal) {
+        size_t length = std::strlen(literal);
+
+        if (size - i < length || std::memcmp(&str[i], literal, length) != 0)
+            fail(string("expected '") + literal + "', got " + describe(i));
+
+        i += length;
+    }
+
+    void parse_value(int depth) {
+        if (depth > max_depth)
+            fail("exceeded maximum nesting depth");
+
+        consume_whitespace();
+
+        char ch = peek(i);
+        uint32_t index;
+
+        if (ch == '-' || (ch >= '0' && ch <= '9')) {
+            index = add_node(JsonType::Number);
+            parse_number(index);
+        } else if (ch == 't') {
+            index = add_node(JsonType::Bool);
+            expect("true");
+            doc.nodes[index].bool_value = true;
+        } else if (ch == 'f') {
+            index = add_node(JsonType::Bool);
+            expect("false");
+        } else if (ch == 'n') {
+            index = add_node(JsonType::Null);
+            expect("null");
+        } else if (ch == '"') {
+            index = add_node(JsonType::String);
+            parse_string(index);
+        } else if (ch == '{') {
+            index = add_node(JsonType::Object);
+            parse_object(index, depth);
+        } else if (ch == '[') {
+            index = add_node(JsonType::Array);
+            parse_array(index, depth);
+        } else {
+            fail("expected value, got " + describe(i));
+        }
+
+        finish_node(index);
+    }
+
+    // Object members are stored as a key node followed by the value's nodes.
+    void parse_object(uint32_t index, int depth) {
+        i++;
+        consume_whitespace();
+
+        if (peek(i) == '}') {
+            i++;
+            return;
+        }
+
+        for (;;) {
+            consume_whitespace();
+
+            if (peek(i) != '"')
+                fail("expected '\"' in object, got " + describe(i));
+
+            uint32_t key = add_node(JsonType::String);
+            parse_string(key);
+            finish_node(key);
+
+            consume_whitespace();
+
+            if (peek(i) != ':')
+                fail("expected ':' in object, got " + describe(i));
+
+            i++;
+            parse_value(depth + 1);
+            doc.nodes[index].count++;
+
+            consume_whitespace();
+
+            char ch = peek(i);
+            i++;
+
+            if (ch == '}')
+                break;
+            if (ch != ',')
+                fail("expected ',' in object, got " + describe(i - 1));
+        }
+    }
+
+    void parse_array(uint32_t index, int depth) {
+        i++;
+        consume_whitespace();
+
+        if (peek(i) == ']') {
+            i++;
+            return;
+        }
+
+        for (;;) {
+            parse_value(depth + 1);
+            doc.nodes[index].count++;
+
+            consume_whitespace();
+
+            char ch = peek(i);
+            i++;
+
+            if (ch == ']')
+                break;
+            if (ch != ',')
+                fail("expected ',' in list, got " + describe(i - 1));
+        }
+    }
+};
+
+JsonDocument::JsonDocument(const string &filepath) : filepath(filepath), text(""), size(0), mapped_size(0) {
+#ifdef _WIN32
+    std::ifstream in_file(filepath, std::ifstream::binary);
+
+    if (!in_file.is_open())
+        FATAL_ERROR("Cannot open file %s for reading.\n", filepath.c_str());
+
+    buffer.assign(std::istreambuf_iterator<char>(in_file), std::istreambuf_iterator<char>());
+    text = buffer.data();
+    size = buffer.size();
+#else
+    int fd = open(filepath.c_str(), O_RDONLY);
+    struct stat st;
+
+    if (fd < 0 || fstat(fd, &st) != 0)
+        FATAL_ERROR("Cannot open file %s for reading.\n", filepath.c_str());
+
+    if (st.st_size > 0) {
+        void *mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (mapping == MAP_FAILED)
+            FATAL_ERROR("Cannot read file %s.\n", filepath.c_str());
+
+        text = static_cast<const char *>(mapping);
+        size = mapped_size = st.st_size;
+    }
+
+    close(fd);
+#endif
+
+    // Map files have a few dozen nodes per kilobyte.
+    nodes.reserve(size / 16 + 1);
+
+    JsonParser parser(*this);
+    parser.parse_document();
+}
+
+JsonDocument::~JsonDocument() {
+#ifndef _WIN32
+    if (mapped_size != 0)
+        munmap(const_cast<char *>(text), mapped_size);
+#endif
+}
+
+JsonValue::iterator &JsonValue::iterator::operator++() {
+    index = doc->nodes[index].end;
+    return *this;
+}
+
+JsonType JsonValue::type() const {
+    return doc ? doc->nodes[index].type : JsonType::Null;
+}
+
+bool JsonValue::bool_value() const {
+    return type() == JsonType::Bool && doc->nodes[index].bool_value;
+}
+
+int JsonValue::int_value() const {
+    return type() == JsonType::Number ? doc->nodes[index].int_value : 0;
+}
+
+StringRef JsonValue::string_value() const {
+    if (type() != JsonType::String)
+        return StringRef();
+
+    const JsonDocument::Node &node = doc->nodes[index];
+    return StringRef(node.str, node.length);
+}
+
+size_t JsonValue::size() const {
+    JsonType t = type();
+    return (t == JsonType::Array || t == JsonType::Object) ? doc->nodes[index].count : 0;
+}
+
+bool JsonValue::has(StringRef key) const {
+    if (type() != JsonType::Object)
+        return false;
+
+    const JsonDocument::Node &node = doc->nodes[index];
+
+    for (uint32_t i = index + 1; i < node.end; i = doc->nodes[i + 1].end) {
+        if (JsonValue(doc, i).string_value() == key)
+            return true;
+    }
+
+    return false;
+}
+
+// Like json11, which keeps members in a std::map, the last of several
+// members with the same key wins.
+JsonValue JsonValue::operator[](StringRef key) const {
+    if (type() != JsonType::Object)
+        return JsonValue();
+
+    const JsonDocument::Node &node = doc->nodes[index];
+    JsonValue result;
+
+    for (uint32_t i = index + 1; i < node.end; i = doc->nodes[i + 1].end) {
+        if (JsonValue(doc, i).string_value() == key)
+            result = JsonValue(doc, i + 1);
+    }
+
+    return result;
+}
+
+JsonValue::iterator JsonValue::begin() const {
+    if (type() != JsonType::Array)
+        return end();
+
+    return iterator(doc, index + 1);
+}
+
+JsonValue::iterator JsonValue::end() const {
+    if (!doc)
+        return iterator(nullptr, 0);
+
+    return iterator(doc, doc->nodes[index].end);
+}
@@ -0,0 +1,131 @@
+// json.h
+
+#ifndef JSON_H
+#define JSON_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+
+// A read-only JSON parser. The whole document is parsed into a flat array of
+// nodes, and strings point straight into the (memory-mapped) source text,
+// so looking values up never allocates.
+
+// A span of characters owned by a JsonDocument.
+struct StringRef {
+    const char *data;
+    size_t length;
+
+    StringRef() : data(""), length(0) {}
+    StringRef(const char *data, size_t length) : data(data), length(length) {}
+
+    std::string str() const { return std::string(data, length); }
+
+    bool operator==(const StringRef &other) const {
+        return length == other.length && std::memcmp(data, other.data, length) == 0;
+    }
+    bool operator!=(const StringRef &other) const { return !(*this == other); }
+    bool operator==(const char *s) const { return *this == StringRef(s, std::strlen(s)); }
+    bool operator!=(const char *s) const { return !(*this == s); }
+};
+
+enum class JsonType : uint8_t {
+    Null,
+    Bool,
+    Number,
+    String,
+    Array,
+    Object,
+};
+
+class JsonDocument;
+
+// A handle to a value in a JsonDocument. Like json11, looking up a missing key
+// or index gives a null value, and the typed accessors return an empty value
+// for anything of the wrong type.
+class JsonValue {
+public:
+    class iterator {
+    public:
+        iterator(const JsonDocument *doc, uint32_t index) : doc(doc), index(index) {}
+        JsonValue operator*() const { return JsonValue(doc, index); }
+        iterator &operator++();
+        bool operator!=(const iterator &other) const { return index != other.index; }
+
+    private:
+        const JsonDocument *doc;
+        uint32_t index;
+    };
+
+    JsonValue() : doc(nullptr), index(0) {}
+
+    JsonType type() const;
+    bool is_null() const { return type() == JsonType::Null; }
+    bool bool_value() const;
+    int int_value() const;
+    StringRef string_value() const;
+
+    // The number of items in an array or members in an object.
+    size_t size() const;
+
+    bool has(StringRef key) const;
+    bool has(const char *key) const { return has(StringRef(key, std::strlen(key))); }
+    JsonValue operator[](StringRef key) const;
+    JsonValue operator[](const char *key) const { return (*this)[StringRef(key, std::strlen(key))]; }
+
+    bool operator==(const char *s) const { return type() == JsonType::String && string_value() == s; }
+
+    // Iterates over the items of an array. Other values are empty.
+    iterator begin() const;
+    iterator end() const;
+
+private:
+    friend class JsonDocument;
+
+    JsonValue(const JsonDocument *doc, uint32_t index) : doc(doc), index(index) {}
+
+    const JsonDocument *doc;
+    uint32_t index;
+};
+
+class JsonDocument {
+public:
+    // Reads and parses a file, exiting with an error if it isn't valid JSON.
+    JsonDocument(const std::string &filepath);
+    JsonDocument(const JsonDocument &) = delete;
+    JsonDocument &operator=(const JsonDocument &) = delete;
+    ~JsonDocument();
+
+    JsonValue root() const { return JsonValue(this, 0); }
+
+private:
+    friend class JsonValue;
+    friend class JsonValue::iterator;
+    friend class JsonParser;
+
+    struct Node {
+        JsonType type;
+        bool bool_value;
+        int int_value;
+        // One past the last node of this value's subtree.
+        uint32_t end;
+        // Number of array items or object members.
+        uint32_t count;
+        const char *str;
+        uint32_t length;
+    };
+
+    std::string filepath;
+    const char *text;
+    size_t size;
+    size_t mapped_size;
+    std::vector<char> buffer;
+    std::vector<Node> nodes;
+    // Strings containing escapes are decoded here.
+    std::deque<std::string> decoded_strings;
+};
+
+#endif // JSON_H
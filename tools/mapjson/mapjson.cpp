@@ -4,13 +4,13 @@
 using std::cout; using std::endl;
 
 #include <string>
-using std::string;
+using std::string; using std::to_string;
 
 #include <vector>
 using std::vector;
 
 #include <algorithm>
-using std::sort; using std::find;
+using std::sort;
 
 #include <map>
 using std::map;
@@ -24,30 +24,36 @@ using std::ostringstream;
 #include <limits>
 using std::numeric_limits;
 
-#include "json11.h"
-using json11::Json;
+#include <thread>
+using std::thread;
 
-#include "mapjson.h"
+#include <atomic>
+using std::atomic;
 
+#include "json.h"
 
-string read_text_file(string filepath) {
-    ifstream in_file(filepath);
+#include "mapjson.h"
 
-    if (!in_file.is_open())
-        FATAL_ERROR("Cannot open file %s for reading.\n", filepath.c_str());
 
-    string text;
+// Builds the text of a generated file in a single growing string.
+class TextBuffer {
+public:
+    TextBuffer() { text.reserve(16 * 1024); }
 
-    in_file.seekg(0, std::ios::end);
-    text.resize(in_file.tellg());
+    TextBuffer &operator<<(const char *s) { text += s; return *this; }
+    TextBuffer &operator<<(const string &s) { text += s; return *this; }
+    TextBuffer &operator<<(StringRef s) { text.append(s.data, s.length); return *this; }
+    TextBuffer &operator<<(int n) { text += to_string(n); return *this; }
+    TextBuffer &operator<<(unsigned int n) { text += to_string(n); return *this; }
+    TextBuffer &operator<<(unsigned long n) { text += to_string(n); return *this; }
+    TextBuffer &operator<<(unsigned long long n) { text += to_string(n); return *this; }
+    TextBuffer &operator<<(bool b) { text += b ? '1' : '0'; return *this; }
 
-    in_file.seekg(0, std::ios::beg);
-    in_file.read(&text[0], text.size());
+    string &str() { return text; }
 
-    in_file.close();
-
-    return text;
-}
+private:
+    string text;
+};
 
 void write_text_file(string filepath, string text) {
     ofstream out_file(filepath, std::ofstream::binary);
@@ -60,38 +66,56 @@ void write_text_file(string filepath, string text) {
     out_file.close();
 }
 
-string generate_map_header_text(Json map_data, Json layouts_data, string version) {
-    string map_layout_id = map_data["layout"].string_value();
+// Writes the file only if its contents would change, so that anything built
+// from it isn't rebuilt for nothing.
+void update_text_file(string filepath, const string &text) {
+    ifstream in_file(filepath, std::ifstream::binary);
+
+    if (in_file.is_open()) {
+        ostringstream old_text;
+        old_text << in_file.rdbuf();
+        in_file.close();
 
-    vector<Json> matched;
+        if (old_text.str() == text)
+            return;
+    }
 
-    for (auto &field : layouts_data["layouts"].array_items()) {
+    write_text_file(filepath, text);
+}
+
+string generate_map_header_text(JsonValue map_data, JsonValue layouts_data, string version) {
+    StringRef map_layout_id = map_data["layout"].string_value();
+
+    vector<JsonValue> matched;
+
+    for (JsonValue field : layouts_data["layouts"]) {
         if (map_layout_id == field["id"].string_value())
             matched.push_back(field);
     }
 
     if (matched.size() != 1)
-        FATAL_ERROR("Failed to find matching layout for %s.\n", map_layout_id.c_str());
+        FATAL_ERROR("Failed to find matching layout for %s.\n", map_layout_id.str().c_str());
 
-    Json layout = matched[0];
+    JsonValue layout = matched[0];
 
-    ostringstream text;
+    TextBuffer text;
 
     text << map_data["name"].string_value() << ":\n"
          << "\t.4byte " << layout["name"].string_value() << "\n";
 
-    if (map_data.object_items().find("shared_events_map") != map_data.object_items().end())
+    if (map_data.has("shared_events_map"))
         text << "\t.4byte " << map_data["shared_events_map"].string_value() << "_MapEvents\n";
     else
         text << "\t.4byte " << map_data["name"].string_value() << "_MapEvents\n";
 
-    if (map_data.object_items().find("shared_scripts_map") != map_data.object_items().end())
+    if (map_data.has("shared_scripts_map"))
         text << "\t.4byte " << map_data["shared_scripts_map"].string_value() << "_MapScripts\n";
     else
         text << "\t.4byte " << map_data["name"].string_value() << "_MapScripts\n";
 
-    if (map_data.object_items().find("connections") != map_data.object_items().end()
-     && map_data["connections"].array_items().size() > 0)
+    if (map_data.has("connections")
+     && map_data["connections"].type() == JsonType::Array
+     && map_data["connections"].size() > 0)
         text << "\t.4byte " << map_data["name"].string_value() << "_MapConnections\n";
     else
         text << "\t.4byte 0x0\n";
@@ -115,45 +139,55 @@ string generate_map_header_text(Json map_data, Json layouts_data, string version
 
      text << "\t.byte " << map_data["battle_scene"].string_value() << "\n\n";
 
-    return text.str();
+    return std::move(text.str());
 }
 
-string generate_map_connections_text(Json map_data) {
-    if (map_data["connections"] == Json())
+string generate_map_connections_text(JsonValue map_data) {
+    JsonValue connections = map_data["connections"];
+
+    if (connections.is_null())
         return string("\n");
 
-    ostringstream text;
+    TextBuffer text;
 
     text << map_data["name"].string_value() << "_MapConnectionsList:\n";
 
-    for (auto &connection : map_data["connections"].array_items()) {
+    for (JsonValue connection : connections) {
         text << "\tconnection "
              << connection["direction"].string_value() << ", "
              << connection["offset"].int_value() << ", "
              << connection["map"].string_value() << "\n";
     }
 
+    size_t num_connections = connections.type() == JsonType::Array ? connections.size() : 0;
+
     text << "\n" << map_data["name"].string_value() << "_MapConnections:\n"
-         << "\t.4byte " << map_data["connections"].array_items().size() << "\n"
+         << "\t.4byte " << num_connections << "\n"
          << "\t.4byte " << map_data["name"].string_value() << "_MapConnectionsList\n\n";
 
-    return text.str();
+    return std::move(text.str());
+}
+
+// The number of items in a member that should be an array.
+static size_t array_size(JsonValue value) {
+    return value.type() == JsonType::Array ? value.size() : 0;
 }
 
-string generate_map_events_text(Json map_data) {
-    if (map_data.object_items().find("shared_events_map") != map_data.object_items().end())
+string generate_map_events_text(JsonValue map_data) {
+    if (map_data.has("shared_events_map"))
         return string("\n");
 
-    ostringstream text;
+    TextBuffer text;
 
     string objects_label, warps_label, coords_label, bgs_label;
+    string map_name = map_data["name"].string_value().str();
 
-    if (map_data["object_events"].array_items().size() > 0) {
-        objects_label = map_data["name"].string_value() + "_ObjectEvents";
+    if (array_size(map_data["object_events"]) > 0) {
+        objects_label = map_name + "_ObjectEvents";
         text << objects_label << ":\n";
-        for (unsigned int i = 0; i < map_data["object_events"].array_items().size(); i++) {
-            auto obj_event = map_data["object_events"].array_items()[i];
-            text << "\tobject_event " << i + 1 << ", "
+        unsigned int i = 0;
+        for (JsonValue obj_event : map_data["object_events"]) {
+            text << "\tobject_event " << ++i << ", "
                  << obj_event["graphics_id"].string_value() << ", 0, "
                  << obj_event["x"].int_value() << ", "
                  << obj_event["y"].int_value() << ", "
@@ -171,10 +205,10 @@ string generate_map_events_text(Json map_data) {
         objects_label = "0x0";
     }
 
-    if (map_data["warp_events"].array_items().size() > 0) {
-        warps_label = map_data["name"].string_value() + "_MapWarps";
+    if (array_size(map_data["warp_events"]) > 0) {
+        warps_label = map_name + "_MapWarps";
         text << warps_label << ":\n";
-        for (auto &warp_event : map_data["warp_events"].array_items()) {
+        for (JsonValue warp_event : map_data["warp_events"]) {
             text << "\twarp_def "
                  << warp_event["x"].int_value() << ", "
                  << warp_event["y"].int_value() << ", "
@@ -187,10 +221,10 @@ string generate_map_events_text(Json map_data) {
         warps_label = "0x0";
     }
 
-    if (map_data["coord_events"].array_items().size() > 0) {
-        coords_label = map_data["name"].string_value() + "_MapCoordEvents";
+    if (array_size(map_data["coord_events"]) > 0) {
+        coords_label = map_name + "_MapCoordEvents";
         text << coords_label << ":\n";
-        for (auto &coord_event : map_data["coord_events"].array_items()) {
+        for (JsonValue coord_event : map_data["coord_events"]) {
             if (coord_event["type"].string_value() == "trigger") {
                 text << "\tcoord_event "
                      << coord_event["x"].int_value() << ", "
@@ -213,10 +247,10 @@ string generate_map_events_text(Json map_data) {
         coords_label = "0x0";
     }
 
-    if (map_data["bg_events"].array_items().size() > 0) {
-        bgs_label = map_data["name"].string_value() + "_MapBGEvents";
+    if (array_size(map_data["bg_events"]) > 0) {
+        bgs_label = map_name + "_MapBGEvents";
         text << bgs_label << ":\n";
-        for (auto &bg_event : map_data["bg_events"].array_items()) {
+        for (JsonValue bg_event : map_data["bg_events"]) {
             if (bg_event["type"] == "sign") {
                 text << "\tbg_event "
                      << bg_event["x"].int_value() << ", "
@@ -246,11 +280,11 @@ string generate_map_events_text(Json map_data) {
         bgs_label = "0x0";
     }
 
-    text << map_data["name"].string_value() << "_MapEvents::\n"
+    text << map_name << "_MapEvents::\n"
          << "\tmap_events " << objects_label << ", " << warps_label << ", "
          << coords_label << ", " << bgs_label << "\n\n";
 
-    return text.str();
+    return std::move(text.str());
 }
 
 string get_directory_name(string filename) {
@@ -260,18 +294,11 @@ string get_directory_name(string filename) {
 }
 
 void process_map(string map_filepath, string layouts_filepath, string version) {
-    string mapdata_err, layouts_err;
-
-    string mapdata_json_text = read_text_file(map_filepath);
-    string layouts_json_text = read_text_file(layouts_filepath);
+    JsonDocument map_doc(map_filepath);
+    JsonDocument layouts_doc(layouts_filepath);
 
-    Json map_data = Json::parse(mapdata_json_text, mapdata_err);
-    if (map_data == Json())
-        FATAL_ERROR("%s\n", mapdata_err.c_str());
-
-    Json layouts_data = Json::parse(layouts_json_text, layouts_err);
-    if (layouts_data == Json())
-        FATAL_ERROR("%s\n", layouts_err.c_str());
+    JsonValue map_data = map_doc.root();
+    JsonValue layouts_data = layouts_doc.root();
 
     string header_text = generate_map_header_text(map_data, layouts_data, version);
     string events_text = generate_map_events_text(map_data);
@@ -283,112 +310,110 @@ void process_map(string map_filepath, string layouts_filepath, string version) {
     write_text_file(files_dir + "connections.inc", connections_text);
 }
 
-string generate_groups_text(Json groups_data) {
-    ostringstream text;
+string generate_groups_text(JsonValue groups_data) {
+    TextBuffer text;
 
-    for (auto &key : groups_data["group_order"].array_items()) {
-        string group = key.string_value();
+    for (JsonValue key : groups_data["group_order"]) {
+        StringRef group = key.string_value();
         text << group << "::\n";
-        auto maps = groups_data[group].array_items();
-        for (Json &map_name : maps)
+        for (JsonValue map_name : groups_data[group])
             text << "\t.4byte " << map_name.string_value() << "\n";
         text << "\n";
     }
 
     text << "\t.align 2\n" << "gMapGroups::\n";
-    for (auto &group : groups_data["group_order"].array_items())
+    for (JsonValue group : groups_data["group_order"])
         text << "\t.4byte " << group.string_value() << "\n";
     text << "\n";
 
-    return text.str();
+    return std::move(text.str());
 }
 
-string generate_connections_text(Json groups_data) {
-    vector<Json> map_names;
+// Lists the names of all maps, group by group.
+static vector<StringRef> get_map_names(JsonValue groups_data) {
+    vector<StringRef> map_names;
 
-    for (auto &group : groups_data["group_order"].array_items())
-    for (auto map_name : groups_data[group.string_value()].array_items())
-        map_names.push_back(map_name);
+    for (JsonValue group : groups_data["group_order"])
+    for (JsonValue map_name : groups_data[group.string_value()])
+        map_names.push_back(map_name.string_value());
 
-    vector<Json> connections_include_order = groups_data["connections_include_order"].array_items();
+    return map_names;
+}
 
-    if (connections_include_order.size() > 0)
-        sort(map_names.begin(), map_names.end(), [connections_include_order](const Json &a, const Json &b) {
-            auto iter_a = find(connections_include_order.begin(), connections_include_order.end(), a);
-            if (iter_a == connections_include_order.end())
-                iter_a = connections_include_order.begin() + numeric_limits<int>::max();
-            auto iter_b = find(connections_include_order.begin(), connections_include_order.end(), b);
-            if (iter_b == connections_include_order.end())
-                iter_b = connections_include_order.begin() + numeric_limits<int>::max();
-            return iter_a < iter_b;
-        });
+string generate_connections_text(JsonValue groups_data) {
+    vector<StringRef> map_names = get_map_names(groups_data);
 
-    ostringstream text;
+    JsonValue connections_include_order = groups_data["connections_include_order"];
 
-    for (Json map_name : map_names)
-        text << "\t.include \"data/maps/" << map_name.string_value() << "/connections.inc\"\n";
+    if (array_size(connections_include_order) > 0) {
+        vector<StringRef> include_order;
+        for (JsonValue map_name : connections_include_order)
+            include_order.push_back(map_name.string_value());
 
-    return text.str();
-}
-
-string generate_headers_text(Json groups_data) {
-    vector<string> map_names;
+        // Maps missing from the include order go after all the others.
+        auto order_of = [&include_order](StringRef map_name) {
+            for (size_t i = 0; i < include_order.size(); i++) {
+                if (include_order[i] == map_name)
+                    return i;
+            }
+            return static_cast<size_t>(numeric_limits<int>::max());
+        };
 
-    for (auto &group : groups_data["group_order"].array_items())
-    for (auto map_name : groups_data[group.string_value()].array_items())
-        map_names.push_back(map_name.string_value());
+        sort(map_names.begin(), map_names.end(), [&order_of](StringRef a, StringRef b) {
+            return order_of(a) < order_of(b);
+        });
+    }
 
-    ostringstream text;
+    TextBuffer text;
 
-    for (string map_name : map_names)
-        text << "\t.include \"data/maps/" << map_name << "/header.inc\"\n";
+    for (StringRef map_name : map_names)
+        text << "\t.include \"data/maps/" << map_name << "/connections.inc\"\n";
 
-    return text.str();
+    return std::move(text.str());
 }
 
-string generate_events_text(Json groups_data) {
-    vector<string> map_names;
+string generate_headers_text(JsonValue groups_data) {
+    TextBuffer text;
 
-    for (auto &group : groups_data["group_order"].array_items())
-    for (auto map_name : groups_data[group.string_value()].array_items())
-        map_names.push_back(map_name.string_value());
+    for (StringRef map_name : get_map_names(groups_data))
+        text << "\t.include \"data/maps/" << map_name << "/header.inc\"\n";
 
-    ostringstream text;
+    return std::move(text.str());
+}
+
+string generate_events_text(JsonValue groups_data) {
+    TextBuffer text;
 
-    for (string map_name : map_names)
+    for (StringRef map_name : get_map_names(groups_data))
         text << "\t.include \"data/maps/" << map_name << "/events.inc\"\n";
 
-    return text.str();
+    return std::move(text.str());
 }
 
-string generate_map_constants_text(string groups_filepath, Json groups_data) {
-    string file_dir = get_directory_name(groups_filepath);
-    char dir_separator = file_dir.back();
-
-    ostringstream text;
+// map_ids holds the "id" of each map.json, keyed by map name.
+string generate_map_constants_text(JsonValue groups_data, const map<string, string> &map_ids) {
+    TextBuffer text;
 
     text << "#ifndef GUARD_CONSTANTS_MAP_GROUPS_H\n"
          << "#define GUARD_CONSTANTS_MAP_GROUPS_H\n\n";
 
     int group_num = 0;
 
-    for (auto &group : groups_data["group_order"].array_items()) {
+    for (JsonValue group : groups_data["group_order"]) {
         text << "// Map Group " << group_num << "\n";
-        vector<Json> map_ids;
+        vector<const string *> group_map_ids;
         size_t max_length = 0;
 
-        for (auto &map_name : groups_data[group.string_value()].array_items()) {
-            string header_filepath = file_dir + map_name.string_value() + dir_separator + "map.json";
-            string err_str;
-            Json map_data = Json::parse(read_text_file(header_filepath), err_str);
-            map_ids.push_back(map_data["id"]);
-            if (map_data["id"].string_value().length() > max_length)
-                max_length = map_data["id"].string_value().length();
+        for (JsonValue map_name : groups_data[group.string_value()]) {
+            const string &map_id = map_ids.at(map_name.string_value().str());
+            group_map_ids.push_back(&map_id);
+            if (map_id.length() > max_length)
+                max_length = map_id.length();
         }
 
         int map_id_num = 0;
-        for (Json map_id : map_ids) {
-            text << "#define " << map_id.string_value() << string((max_length - map_id.string_value().length() + 1), ' ')
+        for (const string *map_id : group_map_ids) {
+            text << "#define " << *map_id << string((max_length - map_id->length() + 1), ' ')
                  << "(" << map_id_num++ << " | (" << group_num << " << 8))\n";
         }
         text << "\n";
@@ -399,15 +424,26 @@ string generate_map_constants_text(string groups_filepath, Json groups_data) {
     text << "#define MAP_GROUPS_COUNT " << group_num << "\n\n";
     text << "#endif // GUARD_CONSTANTS_MAP_GROUPS_H\n";
 
-    return text.str();
+    return std::move(text.str());
 }
 
-void process_groups(string groups_filepath) {
-    string err;
-    Json groups_data = Json::parse(read_text_file(groups_filepath), err);
+string generate_map_constants_text(string groups_filepath, JsonValue groups_data) {
+    string file_dir = get_directory_name(groups_filepath);
+    char dir_separator = file_dir.back();
+    map<string, string> map_ids;
 
-    if (groups_data == Json())
-        FATAL_ERROR("%s\n", err.c_str());
+    for (StringRef map_name : get_map_names(groups_data)) {
+        string header_filepath = file_dir + map_name.str() + dir_separator + "map.json";
+        JsonDocument map_doc(header_filepath);
+        map_ids[map_name.str()] = map_doc.root()["id"].string_value().str();
+    }
+
+    return generate_map_constants_text(groups_data, map_ids);
+}
+
+void process_groups(string groups_filepath) {
+    JsonDocument groups_doc(groups_filepath);
+    JsonValue groups_data = groups_doc.root();
 
     string groups_text = generate_groups_text(groups_data);
     string connections_text = generate_connections_text(groups_data);
@@ -425,62 +461,58 @@ void process_groups(string groups_filepath) {
     write_text_file(file_dir + ".." + s + ".." + s + "include" + s + "constants" + s + "map_groups.h", map_header_text);
 }
 
-string generate_layout_headers_text(Json layouts_data) {
-    ostringstream text;
+string generate_layout_headers_text(JsonValue layouts_data) {
+    TextBuffer text;
 
-    for (auto &layout : layouts_data["layouts"].array_items()) {
-        string border_label = layout["name"].string_value() + "_Border";
-        string blockdata_label = layout["name"].string_value() + "_Blockdata";
-        text << border_label << "::\n"
+    for (JsonValue layout : layouts_data["layouts"]) {
+        StringRef name = layout["name"].string_value();
+        text << name << "_Border::\n"
              << "\t.incbin \"" << layout["border_filepath"].string_value() << "\"\n\n"
-             << blockdata_label << "::\n"
+             << name << "_Blockdata::\n"
              << "\t.incbin \"" << layout["blockdata_filepath"].string_value() << "\"\n\n"
              << "\t.align 2\n"
-             << layout["name"].string_value() << "::\n"
+             << name << "::\n"
              << "\t.4byte " << layout["width"].int_value() << "\n"
              << "\t.4byte " << layout["height"].int_value() << "\n"
-             << "\t.4byte " << border_label << "\n"
-             << "\t.4byte " << blockdata_label << "\n"
+             << "\t.4byte " << name << "_Border\n"
+             << "\t.4byte " << name << "_Blockdata\n"
              << "\t.4byte " << layout["primary_tileset"].string_value() << "\n"
              << "\t.4byte " << layout["secondary_tileset"].string_value() << "\n\n";
     }
 
-    return text.str();
+    return std::move(text.str());
 }
 
-string generate_layouts_table_text(Json layouts_data) {
-    ostringstream text;
+string generate_layouts_table_text(JsonValue layouts_data) {
+    TextBuffer text;
 
     text << "\t.align 2\n"
          << layouts_data["layouts_table_label"].string_value() << "::\n";
 
-    for (auto &layout : layouts_data["layouts"].array_items())
+    for (JsonValue layout : layouts_data["layouts"])
         text << "\t.4byte " << layout["name"].string_value() << "\n";
 
-    return text.str();
+    return std::move(text.str());
 }
 
-string generate_layouts_constants_text(Json layouts_data) {
-    ostringstream text;
+string generate_layouts_constants_text(JsonValue layouts_data) {
+    TextBuffer text;
 
     text << "#ifndef GUARD_CONSTANTS_LAYOUTS_H\n"
          << "#define GUARD_CONSTANTS_LAYOUTS_H\n\n";
 
     int i = 0;
-    for (auto &layout : layouts_data["layouts"].array_items())
+    for (JsonValue layout : layouts_data["layouts"])
         text << "#define " << layout["id"].string_value() << " " << ++i << "\n";
 
     text << "\n#endif // GUARD_CONSTANTS_LAYOUTS_H\n";
 
-    return text.str();
+    return std::move(text.str());
 }
 
 void process_layouts(string layouts_filepath) {
-    string err;
-    Json layouts_data = Json::parse(read_text_file(layouts_filepath), err);
-
-    if (layouts_data == Json())
-        FATAL_ERROR("%s\n", err.c_str());
+    JsonDocument layouts_doc(layouts_filepath);
+    JsonValue layouts_data = layouts_doc.root();
 
     string layout_headers_text = generate_layout_headers_text(layouts_data);
     string layouts_table_text = generate_layouts_table_text(layouts_data);
@@ -494,6 +526,68 @@ void process_layouts(string layouts_filepath) {
     write_text_file(file_dir + ".." + s + ".." + s + "include" + s + "constants" + s + "layouts.h", layouts_constants_text);
 }
 
+// Generates the data of every map, the group tables and the layout tables in
+// one run, parsing each JSON file only once. Maps are processed in parallel,
+// and files whose contents are unchanged are left alone.
+void process_all(string groups_filepath, string layouts_filepath, string version) {
+    JsonDocument groups_doc(groups_filepath);
+    JsonDocument layouts_doc(layouts_filepath);
+
+    JsonValue groups_data = groups_doc.root();
+    JsonValue layouts_data = layouts_doc.root();
+
+    string maps_dir = get_directory_name(groups_filepath);
+    char s = maps_dir.back();
+
+    vector<StringRef> map_names = get_map_names(groups_data);
+    vector<string> map_ids(map_names.size());
+    atomic<size_t> next_map(0);
+
+    auto process_maps = [&]() {
+        for (size_t i = next_map++; i < map_names.size(); i = next_map++) {
+            string files_dir = maps_dir + map_names[i].str() + s;
+            JsonDocument map_doc(files_dir + "map.json");
+            JsonValue map_data = map_doc.root();
+
+            update_text_file(files_dir + "header.inc", generate_map_header_text(map_data, layouts_data, version));
+            update_text_file(files_dir + "events.inc", generate_map_events_text(map_data));
+            update_text_file(files_dir + "connections.inc", generate_map_connections_text(map_data));
+
+            map_ids[i] = map_data["id"].string_value().str();
+        }
+    };
+
+    unsigned int num_threads = thread::hardware_concurrency();
+    vector<thread> threads;
+
+    for (unsigned int i = 1; i < num_threads; i++)
+        threads.emplace_back(process_maps);
+
+    process_maps();
+
+    for (thread &t : threads)
+        t.join();
+
+    map<string, string> map_ids_by_name;
+
+    for (size_t i = 0; i < map_names.size(); i++)
+        map_ids_by_name[map_names[i].str()] = map_ids[i];
+
+    string constants_dir = maps_dir + ".." + s + ".." + s + "include" + s + "constants" + s;
+
+    update_text_file(maps_dir + "groups.inc", generate_groups_text(groups_data));
+    update_text_file(maps_dir + "connections.inc", generate_connections_text(groups_data));
+    update_text_file(maps_dir + "headers.inc", generate_headers_text(groups_data));
+    update_text_file(maps_dir + "events.inc", generate_events_text(groups_data));
+    update_text_file(constants_dir + "map_groups.h", generate_map_constants_text(groups_data, map_ids_by_name));
+
+    string layouts_dir = get_directory_name(layouts_filepath);
+
+    update_text_file(layouts_dir + "layouts.inc", generate_layout_headers_text(layouts_data));
+    update_text_file(layouts_dir + "layouts_table.inc", generate_layouts_table_text(layouts_data));
+    update_text_file(layouts_dir + ".." + s + ".." + s + "include" + s + "constants" + s + "layouts.h", generate_layouts_constants_text(layouts_data));
+}
+
 int main(int argc, char *argv[]) {
     if (argc < 3)
         FATAL_ERROR("USAGE: mapjson <mode> <game-version> [options]\n");
@@ -505,8 +599,8 @@ int main(int argc, char *argv[]) {
 
     char *mode_arg = argv[1];
     string mode(mode_arg);
-    if (mode != "layouts" && mode != "map" && mode != "groups")
-        FATAL_ERROR("ERROR: <mode> must be 'layouts', 'map', or 'groups'.\n");
+    if (mode != "layouts" && mode != "map" && mode != "groups" && mode != "all")
+        FATAL_ERROR("ERROR: <mode> must be 'layouts', 'map', 'groups', or 'all'.\n");
 
     if (mode == "map") {
         if (argc != 5)
@@ -533,6 +627,15 @@ int main(int argc, char *argv[]) {
 
         process_layouts(filepath);
     }
+    else if (mode == "all") {
+        if (argc != 5)
+            FATAL_ERROR("USAGE: mapjson all <game-version> <groups_file> <layouts_file>\n");
+
+        string groups_filepath(argv[3]);
+        string layouts_filepath(argv[4]);
+
+        process_all(groups_filepath, layouts_filepath, version);
+    }
 
     return 0;
 }
@@ -25,27 +25,34 @@
 #include <cassert>
 #include <string>
 #include <set>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <atomic>
 #include "main.h"
 #include "error.h"
 #include "midi.h"
 #include "agb.h"
+#include "toolcache.h"
 
-FILE* g_inputFile = nullptr;
-FILE* g_outputFile = nullptr;
+thread_local std::vector<std::uint8_t> g_inputData;
+thread_local FILE* g_outputFile = nullptr;
 
-std::string g_asmLabel;
-int g_masterVolume = 127;
-int g_voiceGroup = 0;
-int g_priority = 0;
-int g_reverb = -1;
-int g_clocksPerBeat = 1;
-bool g_exactGateTime = false;
-bool g_compressionEnabled = true;
+thread_local std::string g_asmLabel;
+thread_local int g_masterVolume = 127;
+thread_local int g_voiceGroup = 0;
+thread_local int g_priority = 0;
+thread_local int g_reverb = -1;
+thread_local int g_clocksPerBeat = 1;
+thread_local bool g_exactGateTime = false;
+thread_local bool g_compressionEnabled = true;
 
 [[noreturn]] static void PrintUsage()
 {
     std::printf(
         "Usage: MID2AGB name [options]\n"
+        "       MID2AGB --batch list_file\n"
         "\n"
         "    input_file  filename(.mid) of MIDI file\n"
         "   output_file  filename(.s) for AGB file (default:input_file)\n"
@@ -58,6 +65,8 @@ bool g_compressionEnabled = true;
         "            -X  48 clocks/beat (default:24 clocks/beat)\n"
         "            -E  exact gate-time\n"
         "            -N  no compression\n"
+        "\n"
+        "     list_file  file with the arguments for one conversion on each line\n"
     );
     std::exit(1);
 }
@@ -102,13 +111,12 @@ static std::string BaseName(std::string s)
     return s;
 }
 
-static const char *GetArgument(int argc, char **argv, int& index)
+static const char *GetArgument(const std::vector<std::string>& args, std::size_t& index)
 {
-    assert(index >= 0 && index < argc);
+    assert(index < args.size());
 
-    const char *option = argv[index];
+    const char *option = args[index].c_str();
 
-    assert(option != nullptr);
     assert(option[0] == '-');
 
     // If there is text following the letter, return that.
@@ -116,10 +124,10 @@ static const char *GetArgument(int argc, char **argv, int& index)
         return option + 2;
 
     // Otherwise, try to get the next arg.
-    if (index + 1 < argc)
+    if (index + 1 < args.size())
     {
         index++;
-        return argv[index];
+        return args[index].c_str();
     }
     else
     {
@@ -127,14 +135,45 @@ static const char *GetArgument(int argc, char **argv, int& index)
     }
 }
 
-int main(int argc, char** argv)
+static void ReadInputFile(const std::string& filename)
+{
+    FILE* inputFile = std::fopen(filename.c_str(), "rb");
+
+    if (inputFile == nullptr)
+        RaiseError("failed to open \"%s\" for reading", filename.c_str());
+
+    std::fseek(inputFile, 0, SEEK_END);
+    long size = std::ftell(inputFile);
+    std::fseek(inputFile, 0, SEEK_SET);
+
+    g_inputData.resize(size);
+
+    if (size > 0 && std::fread(g_inputData.data(), size, 1, inputFile) != 1)
+        RaiseError("failed to read \"%s\"", filename.c_str());
+
+    std::fclose(inputFile);
+}
+
+// Converts one MIDI file, given the arguments of a single run without the program name.
+// cache may be null.
+static void ConvertFile(const std::vector<std::string>& args, ToolCache* cache)
 {
     std::string inputFilename;
     std::string outputFilename;
 
-    for (int i = 1; i < argc; i++)
+    // This thread may already have converted a file with other options.
+    g_asmLabel.clear();
+    g_masterVolume = 127;
+    g_voiceGroup = 0;
+    g_priority = 0;
+    g_reverb = -1;
+    g_clocksPerBeat = 1;
+    g_exactGateTime = false;
+    g_compressionEnabled = true;
+
+    for (std::size_t i = 0; i < args.size(); i++)
     {
-        const char *option = argv[i];
+        const char *option = args[i].c_str();
 
         if (option[0] == '-' && option[1] != '\0')
         {
@@ -146,13 +185,13 @@ int main(int argc, char** argv)
                 g_exactGateTime = true;
                 break;
             case 'G':
-                arg = GetArgument(argc, argv, i);
+                arg = GetArgument(args, i);
                 if (arg == nullptr)
                     PrintUsage();
                 g_voiceGroup = std::stoi(arg);
                 break;
             case 'L':
-                arg = GetArgument(argc, argv, i);
+                arg = GetArgument(args, i);
                 if (arg == nullptr)
                     PrintUsage();
                 g_asmLabel = arg;
@@ -161,19 +200,19 @@ int main(int argc, char** argv)
                 g_compressionEnabled = false;
                 break;
             case 'P':
-                arg = GetArgument(argc, argv, i);
+                arg = GetArgument(args, i);
                 if (arg == nullptr)
                     PrintUsage();
                 g_priority = std::stoi(arg);
                 break;
             case 'R':
-                arg = GetArgument(argc, argv, i);
+                arg = GetArgument(args, i);
                 if (arg == nullptr)
                     PrintUsage();
                 g_reverb = std::stoi(arg);
                 break;
             case 'V':
-                arg = GetArgument(argc, argv, i);
+                arg = GetArgument(args, i);
                 if (arg == nullptr)
                     PrintUsage();
                 g_masterVolume = std::stoi(arg);
@@ -188,9 +227,9 @@ int main(int argc, char** argv)
         else
         {
             if (inputFilename.empty())
-                inputFilename = argv[i];
+                inputFilename = args[i];
             else if (outputFilename.empty())
-                outputFilename = argv[i];
+                outputFilename = args[i];
             else
                 PrintUsage();
         }
@@ -211,12 +250,24 @@ int main(int argc, char** argv)
     if (g_asmLabel.empty())
         g_asmLabel = BaseName(outputFilename);
 
-    g_inputFile = std::fopen(inputFilename.c_str(), "rb");
+    std::string outputPath = outputFilename;
 
-    if (g_inputFile == nullptr)
-        RaiseError("failed to open \"%s\" for reading", inputFilename.c_str());
+    if (cache != nullptr)
+    {
+        ToolCacheAddInput(cache, inputFilename.c_str());
+
+        if (ToolCacheRestore(cache))
+        {
+            ToolCacheFinish(cache);
+            return;
+        }
+
+        outputPath = ToolCacheAddOutput(cache, outputFilename.c_str());
+    }
+
+    ReadInputFile(inputFilename);
 
-    g_outputFile = std::fopen(outputFilename.c_str(), "w");
+    g_outputFile = std::fopen(outputPath.c_str(), "w");
 
     if (g_outputFile == nullptr)
         RaiseError("failed to open \"%s\" for writing", outputFilename.c_str());
@@ -226,8 +277,61 @@ int main(int argc, char** argv)
     ReadMidiTracks();
     PrintAgbFooter();
 
-    std::fclose(g_inputFile);
     std::fclose(g_outputFile);
 
+    if (cache != nullptr)
+        ToolCacheFinish(cache);
+}
+
+// Runs the conversions listed in a file across all cores.
+static void ConvertBatch(const std::string& listFilename)
+{
+    std::ifstream listFile(listFilename);
+
+    if (!listFile.is_open())
+        RaiseError("failed to open \"%s\" for reading", listFilename.c_str());
+
+    std::vector<std::vector<std::string>> jobs;
+    std::string line;
+
+    while (std::getline(listFile, line))
+    {
+        std::istringstream words(line);
+        std::vector<std::string> args;
+        std::string word;
+
+        while (words >> word)
+            args.push_back(word);
+
+        if (!args.empty())
+            jobs.push_back(args);
+    }
+
+    std::atomic<std::size_t> nextJob(0);
+
+    auto convertFiles = [&]() {
+        for (std::size_t i = nextJob++; i < jobs.size(); i = nextJob++)
+            ConvertFile(jobs[i], nullptr);
+    };
+
+    unsigned numThreads = std::thread::hardware_concurrency();
+    std::vector<std::thread> threads;
+
+    for (unsigned i = 1; i < numThreads; i++)
+        threads.emplace_back(convertFiles);
+
+    convertFiles();
+
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+int main(int argc, char** argv)
+{
+    if (argc == 3 && std::strcmp(argv[1], "--batch") == 0)
+        ConvertBatch(argv[2]);
+    else
+        ConvertFile(std::vector<std::string>(argv + 1, argv + argc), ToolCacheBegin(argc, argv));
+
     return 0;
 }
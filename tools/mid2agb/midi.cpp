@@ -23,7 +23,7 @@
 #include <string>
 #include <vector>
 #include <algorithm>
-#include <memory>
+#include <unordered_map>
 #include "midi.h"
 #include "main.h"
 #include "error.h"
@@ -38,39 +38,64 @@ enum class MidiEventCategory
     Invalid,
 };
 
-MidiFormat g_midiFormat;
-std::int_fast32_t g_midiTrackCount;
-std::int16_t g_midiTimeDiv;
-
-int g_midiChan;
-std::int32_t g_initialWait;
-
-static long s_trackDataStart;
-static std::vector<Event> s_seqEvents;
-static std::vector<Event> s_trackEvents;
-static std::int32_t s_absoluteTime;
-static int s_blockCount = 0;
-static int s_minNote;
-static int s_maxNote;
-static int s_runningStatus;
+thread_local MidiFormat g_midiFormat;
+thread_local std::int_fast32_t g_midiTrackCount;
+thread_local std::int16_t g_midiTimeDiv;
+
+thread_local int g_midiChan;
+thread_local std::int32_t g_initialWait;
+
+// The input file is read from memory, since finding the end of each note
+// means seeking back and forth through the track.
+static thread_local long s_inputPos;
+static thread_local long s_trackDataStart;
+static thread_local std::vector<Event> s_seqEvents;
+static thread_local std::vector<Event> s_trackEvents;
+// A track's events go through each stage of conversion in these two buffers.
+static thread_local std::vector<Event> s_events;
+static thread_local std::vector<Event> s_scratchEvents;
+static thread_local std::int32_t s_absoluteTime;
+static thread_local int s_blockCount = 0;
+static thread_local int s_minNote;
+static thread_local int s_maxNote;
+static thread_local int s_runningStatus;
 
 void Seek(long offset)
 {
-    if (std::fseek(g_inputFile, offset, SEEK_SET) != 0)
+    if (offset < 0)
         RaiseError("failed to seek to %l", offset);
+
+    s_inputPos = offset;
 }
 
 void Skip(long offset)
 {
-    if (std::fseek(g_inputFile, offset, SEEK_CUR) != 0)
+    if (s_inputPos + offset < 0)
         RaiseError("failed to skip %l bytes", offset);
+
+    s_inputPos += offset;
+}
+
+long Tell()
+{
+    return s_inputPos;
+}
+
+bool ReadBytes(char* dest, long length)
+{
+    if (s_inputPos + length > (long)g_inputData.size())
+        return false;
+
+    std::copy(&g_inputData[s_inputPos], &g_inputData[s_inputPos] + length, dest);
+    s_inputPos += length;
+    return true;
 }
 
 std::string ReadSignature()
 {
     char signature[4];
 
-    if (std::fread(signature, 4, 1, g_inputFile) != 1)
+    if (!ReadBytes(signature, 4))
         RaiseError("failed to read signature");
 
     return std::string(signature, 4);
@@ -78,12 +103,10 @@ std::string ReadSignature()
 
 std::uint32_t ReadInt8()
 {
-    int c = std::fgetc(g_inputFile);
-
-    if (c < 0)
+    if (s_inputPos >= (long)g_inputData.size())
         RaiseError("unexpected EOF");
 
-    return c;
+    return g_inputData[s_inputPos++];
 }
 
 std::uint32_t ReadInt16()
@@ -162,7 +185,7 @@ long ReadMidiTrackHeader(long offset)
 
     long size = ReadInt32();
 
-    s_trackDataStart = std::ftell(g_inputFile);
+    s_trackDataStart = Tell();
 
     return size + 8;
 }
@@ -186,7 +209,7 @@ void DetermineEventCategory(MidiEventCategory& category, int& typeChan, int& siz
     if (typeChan < 0x80)
     {
         // If data byte was found, use the running status.
-        ungetc(typeChan, g_inputFile);
+        s_inputPos--;
         typeChan = s_runningStatus;
     }
 
@@ -238,7 +261,7 @@ std::string ReadEventText()
 
     if (length <= 2)
     {
-        if (fread(buffer, length, 1, g_inputFile) != 1)
+        if (!ReadBytes(buffer, length))
             RaiseError("failed to read event text");
     }
     else
@@ -435,7 +458,7 @@ void FindNoteEnd(Event& event)
 {
     // Save the current file position and running status
     // which get modified by CheckNoteEnd.
-    long startPos = ftell(g_inputFile);
+    long startPos = Tell();
     int savedRunningStatus = s_runningStatus;
 
     event.param2 = 0;
@@ -597,9 +620,9 @@ bool EventCompare(const Event& event1, const Event& event2)
     return false;
 }
 
-std::unique_ptr<std::vector<Event>> MergeEvents()
+void MergeEvents(std::vector<Event>& events)
 {
-    std::unique_ptr<std::vector<Event>> events(new std::vector<Event>());
+    events.clear();
 
     unsigned trackEventPos = 0;
     unsigned seqEventPos = 0;
@@ -608,24 +631,22 @@ std::unique_ptr<std::vector<Event>> MergeEvents()
         && s_seqEvents[seqEventPos].type != EventType::EndOfTrack)
     {
         if (EventCompare(s_trackEvents[trackEventPos], s_seqEvents[seqEventPos]))
-            events->push_back(s_trackEvents[trackEventPos++]);
+            events.push_back(s_trackEvents[trackEventPos++]);
         else
-            events->push_back(s_seqEvents[seqEventPos++]);
+            events.push_back(s_seqEvents[seqEventPos++]);
     }
 
     while (s_trackEvents[trackEventPos].type != EventType::EndOfTrack)
-        events->push_back(s_trackEvents[trackEventPos++]);
+        events.push_back(s_trackEvents[trackEventPos++]);
 
     while (s_seqEvents[seqEventPos].type != EventType::EndOfTrack)
-        events->push_back(s_seqEvents[seqEventPos++]);
+        events.push_back(s_seqEvents[seqEventPos++]);
 
     // Push the EndOfTrack event with the larger time.
     if (EventCompare(s_trackEvents[trackEventPos], s_seqEvents[seqEventPos]))
-        events->push_back(s_seqEvents[seqEventPos]);
+        events.push_back(s_seqEvents[seqEventPos]);
     else
-        events->push_back(s_trackEvents[trackEventPos]);
-
-    return events;
+        events.push_back(s_trackEvents[trackEventPos]);
 }
 
 void ConvertTimes(std::vector<Event>& events)
@@ -651,9 +672,9 @@ void ConvertTimes(std::vector<Event>& events)
     }
 }
 
-std::unique_ptr<std::vector<Event>> InsertTimingEvents(std::vector<Event>& inEvents)
+void InsertTimingEvents(const std::vector<Event>& inEvents, std::vector<Event>& outEvents)
 {
-    std::unique_ptr<std::vector<Event>> outEvents(new std::vector<Event>());
+    outEvents.clear();
 
     Event timingEvent = {};
     timingEvent.time = 0;
@@ -664,7 +685,7 @@ std::unique_ptr<std::vector<Event>> InsertTimingEvents(std::vector<Event>& inEve
     {
         while (EventCompare(timingEvent, event))
         {
-            outEvents->push_back(timingEvent);
+            outEvents.push_back(timingEvent);
             timingEvent.time += timingEvent.param2;
         }
 
@@ -674,21 +695,19 @@ std::unique_ptr<std::vector<Event>> InsertTimingEvents(std::vector<Event>& inEve
             {
                 Event originalTimingEvent = event;
                 originalTimingEvent.type = EventType::OriginalTimeSignature;
-                outEvents->push_back(originalTimingEvent);
+                outEvents.push_back(originalTimingEvent);
             }
             timingEvent.param2 = event.param2;
             timingEvent.time = event.time + timingEvent.param2;
         }
 
-        outEvents->push_back(event);
+        outEvents.push_back(event);
     }
-
-    return outEvents;
 }
 
-std::unique_ptr<std::vector<Event>> SplitTime(std::vector<Event>& inEvents)
+void SplitTime(const std::vector<Event>& inEvents, std::vector<Event>& outEvents)
 {
-    std::unique_ptr<std::vector<Event>> outEvents(new std::vector<Event>());
+    outEvents.clear();
 
     std::int32_t time = 0;
 
@@ -707,7 +726,7 @@ std::unique_ptr<std::vector<Event>> SplitTime(std::vector<Event>& inEvents)
                 Event timeSplitEvent = {};
                 timeSplitEvent.time = time;
                 timeSplitEvent.type = EventType::TimeSplit;
-                outEvents->push_back(timeSplitEvent);
+                outEvents.push_back(timeSplitEvent);
             }
         }
 
@@ -718,42 +737,34 @@ std::unique_ptr<std::vector<Event>> SplitTime(std::vector<Event>& inEvents)
             Event timeSplitEvent = {};
             timeSplitEvent.time = time + lutValue;
             timeSplitEvent.type = EventType::TimeSplit;
-            outEvents->push_back(timeSplitEvent);
+            outEvents.push_back(timeSplitEvent);
         }
 
         time = event.time;
 
-        outEvents->push_back(event);
+        outEvents.push_back(event);
     }
-
-    return outEvents;
 }
 
-std::unique_ptr<std::vector<Event>> CreateTies(std::vector<Event>& inEvents)
+// The EndOfTie events are appended, and end up after their notes once the
+// events are sorted.
+void CreateTies(std::vector<Event>& events)
 {
-    std::unique_ptr<std::vector<Event>> outEvents(new std::vector<Event>());
+    std::size_t count = events.size();
 
-    for (const Event& event : inEvents)
+    for (std::size_t i = 0; i < count; i++)
     {
-        if (event.type == EventType::Note && event.param2 > 96)
+        if (events[i].type == EventType::Note && events[i].param2 > 96)
         {
-            Event tieEvent = event;
-            tieEvent.param2 = -1;
-            outEvents->push_back(tieEvent);
-
             Event eotEvent = {};
-            eotEvent.time = event.time + event.param2;
+            eotEvent.time = events[i].time + events[i].param2;
             eotEvent.type = EventType::EndOfTie;
-            eotEvent.note = event.note;
-            outEvents->push_back(eotEvent);
-        }
-        else
-        {
-            outEvents->push_back(event);
+            eotEvent.note = events[i].note;
+            events.push_back(eotEvent);
+
+            events[i].param2 = -1;
         }
     }
-
-    return outEvents;
 }
 
 void CalculateWaits(std::vector<Event>& events)
@@ -873,17 +884,40 @@ bool IsCompressionMatch(std::vector<Event>& events, int index1, int index2)
     return IsPatternBoundary(events[index2].type);
 }
 
-void CompressWholeNote(std::vector<Event>& events, int index)
+// Hashes the parts of a whole note that IsCompressionMatch compares.
+std::uint64_t HashWholeNote(std::vector<Event>& events, int index)
 {
-    for (int j = index + 1; events[j].type != EventType::EndOfTrack; j++)
+    std::uint64_t hash = 14695981039346656037ULL;
+
+    auto mix = [&hash](std::uint64_t value) {
+        hash ^= value;
+        hash *= 1099511628211ULL;
+    };
+
+    mix((unsigned)events[index].type);
+    mix(events[index].note);
+    mix(events[index].param1);
+    mix((std::uint32_t)events[index].time);
+
+    do
     {
-        while (events[j].type != EventType::WholeNoteMark)
-        {
-            j++;
+        index++;
+        mix((unsigned)events[index].type);
+        mix(events[index].note);
+        mix(events[index].param1);
+        mix((std::uint32_t)events[index].param2);
+        mix((std::uint32_t)events[index].time);
+    } while (!IsPatternBoundary(events[index + 1].type));
 
-            if (events[j].type == EventType::EndOfTrack)
-                return;
-        }
+    return hash;
+}
+
+void CompressWholeNote(std::vector<Event>& events, int index, const std::vector<int>& candidates)
+{
+    for (int j : candidates)
+    {
+        if (j <= index || events[j].type != EventType::WholeNoteMark)
+            continue;
 
         if (IsCompressionMatch(events, index, j))
         {
@@ -896,6 +930,22 @@ void CompressWholeNote(std::vector<Event>& events, int index)
 
 void Compress(std::vector<Event>& events)
 {
+    // Only whole notes with the same hash can match, so group them up front
+    // rather than comparing each whole note with every one after it. Whole
+    // notes that are empty never score high enough to be compressed and
+    // never match one that does.
+    std::unordered_map<std::uint64_t, std::vector<int>> wholeNotesByHash;
+    std::vector<std::uint64_t> hashes(events.size());
+
+    for (int i = 0; events[i].type != EventType::EndOfTrack; i++)
+    {
+        if (events[i].type == EventType::WholeNoteMark && !IsPatternBoundary(events[i + 1].type))
+        {
+            hashes[i] = HashWholeNote(events, i);
+            wholeNotesByHash[hashes[i]].push_back(i);
+        }
+    }
+
     for (int i = 0; events[i].type != EventType::EndOfTrack; i++)
     {
         while (events[i].type != EventType::WholeNoteMark)
@@ -908,7 +958,7 @@ void Compress(std::vector<Event>& events)
 
         if (CalculateCompressionScore(events, i) >= 6)
         {
-            CompressWholeNote(events, i);
+            CompressWholeNote(events, i, wholeNotesByHash[hashes[i]]);
         }
     }
 }
@@ -917,6 +967,9 @@ void ReadMidiTracks()
 {
     long trackHeaderStart = 14;
 
+    s_seqEvents.clear();
+    s_blockCount = 0;
+
     ReadMidiTrackHeader(trackHeaderStart);
     ReadSeqEvents();
 
@@ -936,7 +989,7 @@ void ReadMidiTracks()
                 printf("Track%d = Midi-Ch.%d\n", g_agbTrack, g_midiChan + 1);
 #endif
 
-                std::unique_ptr<std::vector<Event>> events(MergeEvents());
+                MergeEvents(s_events);
 
                 // We don't need TEMPO in anything but track 1.
                 if (g_agbTrack == 1)
@@ -945,17 +998,19 @@ void ReadMidiTracks()
                     s_seqEvents.erase(it, s_seqEvents.end());
                 }
 
-                ConvertTimes(*events);
-                events = InsertTimingEvents(*events);
-                events = CreateTies(*events);
-                std::stable_sort(events->begin(), events->end(), EventCompare);
-                events = SplitTime(*events);
-                CalculateWaits(*events);
+                ConvertTimes(s_events);
+                InsertTimingEvents(s_events, s_scratchEvents);
+                s_events.swap(s_scratchEvents);
+                CreateTies(s_events);
+                std::stable_sort(s_events.begin(), s_events.end(), EventCompare);
+                SplitTime(s_events, s_scratchEvents);
+                s_events.swap(s_scratchEvents);
+                CalculateWaits(s_events);
 
                 if (g_compressionEnabled)
-                    Compress(*events);
+                    Compress(s_events);
 
-                PrintAgbTrack(*events);
+                PrintAgbTrack(s_events);
 
                 g_agbTrack++;
             }
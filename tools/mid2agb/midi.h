@@ -76,8 +76,8 @@ struct Event
 void ReadMidiFileHeader();
 void ReadMidiTracks();
 
-extern int g_midiChan;
-extern std::int32_t g_initialWait;
+extern thread_local int g_midiChan;
+extern thread_local std::int32_t g_initialWait;
 
 inline bool IsPatternBoundary(EventType type)
 {
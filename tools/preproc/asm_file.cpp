@@ -21,125 +21,136 @@
 #include <cstdio>
 #include <cstdarg>
 #include <stdexcept>
+#include <map>
 #include "preproc.h"
 #include "asm_file.h"
 #include "char_util.h"
 #include "utf8.h"
 #include "string_parser.h"
 
-AsmFile::AsmFile(std::string filename) : m_filename(filename)
-{
-    FILE *fp = std::fopen(filename.c_str(), "rb");
-
-    if (fp == NULL)
-        FATAL_ERROR("Failed to open \"%s\" for reading.\n", filename.c_str());
-
-    std::fseek(fp, 0, SEEK_END);
-
-    m_size = std::ftell(fp);
-
-    if (m_size < 0)
-        FATAL_ERROR("File size of \"%s\" is less than zero.\n", filename.c_str());
-
-    m_buffer = new char[m_size + 1];
-
-    std::rewind(fp);
-
-    if (std::fread(m_buffer, m_size, 1, fp) != 1)
-        FATAL_ERROR("Failed to read \"%s\".\n", filename.c_str());
-
-    m_buffer[m_size] = 0;
-
-    std::fclose(fp);
-
-    m_pos = 0;
-    m_lineNum = 1;
-    m_lineStart = 0;
-
-    RemoveComments();
-}
-
-AsmFile::AsmFile(AsmFile&& other) : m_filename(std::move(other.m_filename))
-{
-    m_buffer = other.m_buffer;
-    m_pos = other.m_pos;
-    m_size = other.m_size;
-    m_lineNum = other.m_lineNum;
-    m_lineStart = other.m_lineStart;
-
-    other.m_buffer = nullptr;
-}
-
-AsmFile::~AsmFile()
-{
-    delete[] m_buffer;
-}
-
 // Removes comments to simplify further processing.
 // It stops upon encountering a null character,
 // which may or may not be the end of file marker.
 // If it's not, the error will be caught later.
-void AsmFile::RemoveComments()
+static void RemoveComments(char* buffer)
 {
     long pos = 0;
     char stringChar = 0;
 
     for (;;)
     {
-        if (m_buffer[pos] == 0)
+        if (buffer[pos] == 0)
             return;
 
         if (stringChar != 0)
         {
-            if (m_buffer[pos] == '\\' && m_buffer[pos + 1] == stringChar)
+            if (buffer[pos] == '\\' && buffer[pos + 1] == stringChar)
             {
                 pos += 2;
             }
             else
             {
-                if (m_buffer[pos] == stringChar)
+                if (buffer[pos] == stringChar)
                     stringChar = 0;
                 pos++;
             }
         }
-        else if (m_buffer[pos] == '@' && (pos == 0 || m_buffer[pos - 1] != '\\'))
+        else if (buffer[pos] == '@' && (pos == 0 || buffer[pos - 1] != '\\'))
         {
-            while (m_buffer[pos] != '\n' && m_buffer[pos] != 0)
-                m_buffer[pos++] = ' ';
+            while (buffer[pos] != '\n' && buffer[pos] != 0)
+                buffer[pos++] = ' ';
         }
-        else if (m_buffer[pos] == '/' && m_buffer[pos + 1] == '*')
+        else if (buffer[pos] == '/' && buffer[pos + 1] == '*')
         {
-            m_buffer[pos++] = ' ';
-            m_buffer[pos++] = ' ';
+            buffer[pos++] = ' ';
+            buffer[pos++] = ' ';
 
             for (;;)
             {
-                if (m_buffer[pos] == 0)
+                if (buffer[pos] == 0)
                     return;
 
-                if (m_buffer[pos] == '*' && m_buffer[pos + 1] == '/')
+                if (buffer[pos] == '*' && buffer[pos + 1] == '/')
                 {
-                    m_buffer[pos++] = ' ';
-                    m_buffer[pos++] = ' ';
+                    buffer[pos++] = ' ';
+                    buffer[pos++] = ' ';
                     break;
                 }
                 else
                 {
-                    if (m_buffer[pos] != '\n')
-                        m_buffer[pos] = ' ';
+                    if (buffer[pos] != '\n')
+                        buffer[pos] = ' ';
                     pos++;
                 }
             }
         }
         else
         {
-            if (m_buffer[pos] == '"' || m_buffer[pos] == '\'')
-                stringChar = m_buffer[pos];
+            if (buffer[pos] == '"' || buffer[pos] == '\'')
+                stringChar = buffer[pos];
             pos++;
         }
     }
 }
 
+// Most files are only included once, so a buffer is only kept around once a
+// file has been seen a second time. Holding on to every buffer costs more in
+// fresh allocations than it saves.
+static std::shared_ptr<const AsmFileBuffer> ReadAsmFileBuffer(const std::string& filename)
+{
+    static std::map<std::string, std::shared_ptr<const AsmFileBuffer>> s_cache;
+
+    auto it = s_cache.find(filename);
+
+    if (it != s_cache.end() && it->second)
+        return it->second;
+
+    FILE *fp = std::fopen(filename.c_str(), "rb");
+
+    if (fp == NULL)
+        FATAL_ERROR("Failed to open \"%s\" for reading.\n", filename.c_str());
+
+    std::fseek(fp, 0, SEEK_END);
+
+    long size = std::ftell(fp);
+
+    if (size < 0)
+        FATAL_ERROR("File size of \"%s\" is less than zero.\n", filename.c_str());
+
+    std::shared_ptr<AsmFileBuffer> buffer = std::make_shared<AsmFileBuffer>();
+    buffer->data.reset(new char[size + 1]);
+    buffer->size = size;
+
+    std::rewind(fp);
+
+    if (std::fread(buffer->data.get(), size, 1, fp) != 1)
+        FATAL_ERROR("Failed to read \"%s\".\n", filename.c_str());
+
+    buffer->data[size] = 0;
+
+    std::fclose(fp);
+
+    RemoveComments(buffer->data.get());
+
+    if (it != s_cache.end())
+        it->second = buffer;
+    else
+        s_cache.emplace(filename, nullptr);
+
+    return buffer;
+}
+
+AsmFile::AsmFile(std::string filename) : m_filename(filename)
+{
+    m_contents = ReadAsmFileBuffer(filename);
+    m_buffer = m_contents->data.get();
+    m_size = m_contents->size;
+
+    m_pos = 0;
+    m_lineNum = 1;
+    m_lineStart = 0;
+}
+
 // Checks if we're at a particular directive and if so, consumes it.
 // Returns whether the directive was found.
 bool AsmFile::CheckForDirective(std::string name)
@@ -440,7 +451,8 @@ void AsmFile::OutputLine()
         if (m_pos >= m_size)
         {
             RaiseWarning("file doesn't end with newline");
-            puts(&m_buffer[m_lineStart]);
+            g_output.Write(&m_buffer[m_lineStart], m_pos - m_lineStart);
+            g_output.Put('\n');
         }
         else
         {
@@ -449,10 +461,8 @@ void AsmFile::OutputLine()
     }
     else
     {
-        m_buffer[m_pos] = 0;
-        puts(&m_buffer[m_lineStart]);
-        m_buffer[m_pos] = '\n';
         m_pos++;
+        g_output.Write(&m_buffer[m_lineStart], m_pos - m_lineStart);
         m_lineStart = m_pos;
         m_lineNum++;
     }
@@ -497,7 +507,11 @@ bool AsmFile::IsAtEnd()
 // Output the current location to set gas's logical file and line numbers.
 void AsmFile::OutputLocation()
 {
-    std::printf("# %ld \"%s\"\n", m_lineNum, m_filename.c_str());
+    g_output.Write("# ");
+    g_output.WriteDecimal(m_lineNum);
+    g_output.Write(" \"", 2);
+    g_output.Write(m_filename.c_str(), m_filename.length());
+    g_output.Write("\"\n", 2);
 }
 
 // Reports a diagnostic message.
@@ -24,8 +24,17 @@
 #include <cstdarg>
 #include <cstdint>
 #include <string>
+#include <memory>
 #include "preproc.h"
 
+// The comment-stripped contents of a file. Buffers are cached by path and
+// shared by every AsmFile that reads the same file, so they are never modified.
+struct AsmFileBuffer
+{
+    std::unique_ptr<char[]> data;
+    long size;
+};
+
 enum class Directive
 {
     Include,
@@ -38,9 +47,8 @@ class AsmFile
 {
 public:
     AsmFile(std::string filename);
-    AsmFile(AsmFile&& other);
+    AsmFile(AsmFile&& other) = default;
     AsmFile(const AsmFile&) = delete;
-    ~AsmFile();
     Directive GetDirective();
     std::string GetGlobalLabel();
     std::string ReadPath();
@@ -51,7 +59,8 @@ public:
     void OutputLocation();
 
 private:
-    char* m_buffer;
+    std::shared_ptr<const AsmFileBuffer> m_contents;
+    const char* m_buffer;
     long m_pos;
     long m_size;
     long m_lineNum;
@@ -60,7 +69,6 @@ private:
 
     bool ConsumeComma();
     int ReadPadLength();
-    void RemoveComments();
     bool CheckForDirective(std::string name);
     void SkipWhitespace();
     void ExpectEmptyRestOfLine();
@@ -73,36 +73,76 @@ CFile::~CFile()
     delete[] m_buffer;
 }
 
+// Returns the length of the run starting at pos that contains none of the
+// characters in stopChars, counting the newlines in it.
+static long ScanRun(const char* buffer, long pos, long size, const bool* stopChars, long& newlines)
+{
+    long start = pos;
+
+    while (pos < size && !stopChars[(unsigned char)buffer[pos]])
+    {
+        if (buffer[pos] == '\n')
+            newlines++;
+        pos++;
+    }
+
+    return pos - start;
+}
+
 void CFile::Preproc()
 {
+    // Outside of literals, only these characters can start something that
+    // needs converting or change the state. Everything else is copied through.
+    bool codeStopChars[256] = {};
+    codeStopChars[(unsigned char)'_'] = true;
+    codeStopChars[(unsigned char)'I'] = true;
+    codeStopChars[(unsigned char)'"'] = true;
+    codeStopChars[(unsigned char)'\''] = true;
+
+    bool stringStopChars[256] = {};
+    stringStopChars[(unsigned char)'\\'] = true;
+
     char stringChar = 0;
 
     while (m_pos < m_size)
     {
         if (stringChar)
         {
+            stringStopChars[(unsigned char)stringChar] = true;
+            long length = ScanRun(m_buffer, m_pos, m_size, stringStopChars, m_lineNum);
+            stringStopChars[(unsigned char)stringChar] = false;
+
+            g_output.Write(&m_buffer[m_pos], length);
+            m_pos += length;
+
+            if (m_pos >= m_size)
+                break;
+
             if (m_buffer[m_pos] == stringChar)
             {
-                std::putchar(stringChar);
+                g_output.Put(stringChar);
                 m_pos++;
                 stringChar = 0;
             }
             else if (m_buffer[m_pos] == '\\' && m_buffer[m_pos + 1] == stringChar)
             {
-                std::putchar('\\');
-                std::putchar(stringChar);
+                g_output.Put('\\');
+                g_output.Put(stringChar);
                 m_pos += 2;
             }
             else
             {
-                if (m_buffer[m_pos] == '\n')
-                    m_lineNum++;
-                std::putchar(m_buffer[m_pos]);
+                g_output.Put(m_buffer[m_pos]);
                 m_pos++;
             }
         }
         else
         {
+            long length = ScanRun(m_buffer, m_pos, m_size, codeStopChars, m_lineNum);
+
+            g_output.Write(&m_buffer[m_pos], length);
+            m_pos += length;
+
             TryConvertString();
             TryConvertIncbin();
 
@@ -111,7 +151,7 @@ void CFile::Preproc()
 
             char c = m_buffer[m_pos++];
 
-            std::putchar(c);
+            g_output.Put(c);
 
             if (c == '\n')
                 m_lineNum++;
@@ -140,7 +180,7 @@ bool CFile::ConsumeNewline()
     {
         m_pos += 2;
         m_lineNum++;
-        std::putchar('\n');
+        g_output.Put('\n');
         return true;
     }
 
@@ -148,7 +188,7 @@ bool CFile::ConsumeNewline()
     {
         m_pos++;
         m_lineNum++;
-        std::putchar('\n');
+        g_output.Put('\n');
         return true;
     }
 
@@ -191,7 +231,7 @@ void CFile::TryConvertString()
 
     SkipWhitespace();
 
-    std::printf("{ ");
+    g_output.Write("{ ", 2);
 
     while (1)
     {
@@ -213,7 +253,10 @@ void CFile::TryConvertString()
             }
 
             for (int i = 0; i < length; i++)
-                printf("0x%02X, ", s[i]);
+            {
+                g_output.WriteHexByte(s[i]);
+                g_output.Write(", ", 2);
+            }
         }
         else if (m_buffer[m_pos] == ')')
         {
@@ -232,9 +275,9 @@ void CFile::TryConvertString()
     }
 
     if (noTerminator)
-        std::printf(" }");
+        g_output.Write(" }", 2);
     else
-        std::printf("0xFF }");
+        g_output.Write("0xFF }", 6);
 }
 
 bool CFile::CheckIdentifier(const std::string& ident)
@@ -326,7 +369,7 @@ void CFile::TryConvertIncbin()
 
     m_pos++;
 
-    std::printf("{");
+    g_output.Put('{');
 
     while (true)
     {
@@ -377,9 +420,15 @@ void CFile::TryConvertIncbin()
             offset += size;
 
             if (isSigned)
-                std::printf("%d,", data);
+            {
+                g_output.WriteDecimal(data);
+                g_output.Put(',');
+            }
             else
-                std::printf("%uu,", data);
+            {
+                g_output.WriteUnsigned((unsigned int)data);
+                g_output.Write("u,", 2);
+            }
         }
 
         SkipWhitespace();
@@ -395,7 +444,7 @@ void CFile::TryConvertIncbin()
 
     m_pos++;
 
-    std::printf("}");
+    g_output.Put('}');
 }
 
 // Reports a diagnostic message.
@@ -21,6 +21,17 @@
 #include <cstdio>
 #include <cstdint>
 #include <cstdarg>
+#include <cstring>
+#include <vector>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 #include "preproc.h"
 #include "charmap.h"
 #include "char_util.h"
@@ -369,8 +380,98 @@ void CharmapReader::SkipWhitespace()
         m_pos++;
 }
 
-Charmap::Charmap(std::string filename)
+static const char kCharmapImageMagic[4] = { 'P', 'C', 'M', 'P' };
+static const std::uint32_t kCharmapImageVersion = 2;
+
+// FNV-1a
+static std::uint64_t HashBytes(const char* data, std::size_t size)
 {
+    std::uint64_t hash = 0xCBF29CE484222325ULL;
+
+    for (std::size_t i = 0; i < size; i++)
+    {
+        hash ^= (unsigned char)data[i];
+        hash *= 0x100000001B3ULL;
+    }
+
+    return hash;
+}
+
+std::uint32_t HashCharmapConstant(const char* name, std::size_t length)
+{
+    std::uint32_t hash = 0x811C9DC5;
+
+    for (std::size_t i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)name[i];
+        hash *= 0x01000193;
+    }
+
+    return hash;
+}
+
+static bool ReadSource(std::string filename, std::vector<char>& source)
+{
+    FILE *fp = std::fopen(filename.c_str(), "rb");
+
+    if (fp == NULL)
+        return false;
+
+    std::fseek(fp, 0, SEEK_END);
+    long size = std::ftell(fp);
+    std::rewind(fp);
+
+    source.resize(size > 0 ? size : 0);
+    bool ok = (size >= 0) && (size == 0 || std::fread(source.data(), size, 1, fp) == 1);
+
+    std::fclose(fp);
+    return ok;
+}
+
+class CharmapImageWriter
+{
+public:
+    CharmapImageWriter() : m_image(sizeof(CharmapImageHeader)) {}
+
+    CharmapImageSpan AddString(const std::string& s)
+    {
+        CharmapImageSpan span = { (std::uint32_t)m_image.size(), (std::uint32_t)s.length() };
+        m_image.insert(m_image.end(), s.begin(), s.end());
+        return span;
+    }
+
+    std::uint32_t AddData(const void* data, std::size_t size)
+    {
+        // Keep the tables aligned so they can be used in place.
+        while (m_image.size() % 8 != 0)
+            m_image.push_back(0);
+
+        std::uint32_t offset = m_image.size();
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        m_image.insert(m_image.end(), bytes, bytes + size);
+        return offset;
+    }
+
+    CharmapImageHeader& Header()
+    {
+        return *reinterpret_cast<CharmapImageHeader*>(m_image.data());
+    }
+
+    std::vector<unsigned char>& Image()
+    {
+        return m_image;
+    }
+
+private:
+    std::vector<unsigned char> m_image;
+};
+
+static void CompileCharmap(std::string filename, std::vector<unsigned char>& image)
+{
+    std::map<std::int32_t, std::string> chars;
+    std::string escapes[128];
+    std::map<std::string, std::string> constants;
+
     CharmapReader reader(filename);
 
     for (;;)
@@ -378,7 +479,7 @@ Charmap::Charmap(std::string filename)
         Lhs lhs = reader.ReadLhs();
 
         if (lhs.type == LhsType::None)
-            return;
+            break;
 
         reader.ExpectEqualsSign();
 
@@ -387,22 +488,235 @@ Charmap::Charmap(std::string filename)
         switch (lhs.type)
         {
         case LhsType::Char:
-            if (m_chars.find(lhs.code) != m_chars.end())
+            if (chars.find(lhs.code) != chars.end())
                 reader.RaiseError("redefining char");
-            m_chars[lhs.code] = sequence;
+            chars[lhs.code] = sequence;
             break;
         case LhsType::Escape:
-            if (m_escapes[lhs.code].length() != 0)
+            if (escapes[lhs.code].length() != 0)
                 reader.RaiseError("redefining escape");
-            m_escapes[lhs.code] = sequence;
+            escapes[lhs.code] = sequence;
             break;
         case LhsType::Constant:
-            if (m_constants.find(lhs.name) != m_constants.end())
+            if (constants.find(lhs.name) != constants.end())
                 reader.RaiseError("redefining constant");
-            m_constants[lhs.name] = sequence;
+            constants[lhs.name] = sequence;
             break;
         }
 
         reader.ExpectEmptyRestOfLine();
     }
+
+    CharmapImageWriter writer;
+    CharmapImageSpan escapeSpans[128];
+
+    for (int i = 0; i < 128; i++)
+        escapeSpans[i] = writer.AddString(escapes[i]);
+
+    std::vector<std::uint16_t> pageDirectory(kCharmapNumPageDirectoryEntries, 0);
+    std::vector<CharmapImageSpan> pages(kCharmapPageSize, CharmapImageSpan{ 0, 0 });
+
+    for (const auto& pair : chars)
+    {
+        if (pair.first < 0 || pair.first >= kCharmapMaxCode)
+            continue;
+
+        std::uint16_t& page = pageDirectory[pair.first >> kCharmapPageShift];
+
+        if (page == 0)
+        {
+            page = pages.size() / kCharmapPageSize;
+            pages.resize(pages.size() + kCharmapPageSize, CharmapImageSpan{ 0, 0 });
+        }
+
+        pages[page * kCharmapPageSize + (pair.first & (kCharmapPageSize - 1))] = writer.AddString(pair.second);
+    }
+
+    // Keep the hash table at most half full so probe sequences stay short.
+    std::uint32_t tableSize = 1;
+
+    while (tableSize < constants.size() * 2)
+        tableSize *= 2;
+
+    std::vector<CharmapImageConstant> constantTable(tableSize, CharmapImageConstant{ { 0, 0 }, { 0, 0 } });
+
+    for (const auto& pair : constants)
+    {
+        std::uint32_t slot = HashCharmapConstant(pair.first.data(), pair.first.length()) & (tableSize - 1);
+
+        while (constantTable[slot].name.length != 0)
+            slot = (slot + 1) & (tableSize - 1);
+
+        CharmapImageSpan name = writer.AddString(pair.first);
+        constantTable[slot] = { name, writer.AddString(pair.second) };
+    }
+
+    std::uint32_t pageDirectoryOffset = writer.AddData(pageDirectory.data(), pageDirectory.size() * sizeof(std::uint16_t));
+    std::uint32_t pagesOffset = writer.AddData(pages.data(), pages.size() * sizeof(CharmapImageSpan));
+    std::uint32_t constantTableOffset = writer.AddData(constantTable.data(), constantTable.size() * sizeof(CharmapImageConstant));
+
+    CharmapImageHeader& header = writer.Header();
+    std::memcpy(header.magic, kCharmapImageMagic, sizeof(header.magic));
+    header.version = kCharmapImageVersion;
+    header.imageSize = writer.Image().size();
+    header.pageDirectoryOffset = pageDirectoryOffset;
+    header.pagesOffset = pagesOffset;
+    header.constantTableMask = tableSize - 1;
+    header.constantTableOffset = constantTableOffset;
+    std::memcpy(header.escapes, escapeSpans, sizeof(escapeSpans));
+
+    image.swap(writer.Image());
+}
+
+// The cache is written under a temporary name and renamed into place, so
+// parallel builds never see a partially written image.
+static void WriteCharmapImage(std::string cachePath, const std::vector<unsigned char>& image)
+{
+    std::string tempPath = cachePath + "." + std::to_string(getpid()) + ".tmp";
+    FILE *fp = std::fopen(tempPath.c_str(), "wb");
+
+    if (fp == NULL)
+        return;
+
+    bool ok = (std::fwrite(image.data(), image.size(), 1, fp) == 1);
+
+    if (std::fclose(fp) != 0 || !ok)
+    {
+        std::remove(tempPath.c_str());
+        return;
+    }
+
+    if (std::rename(tempPath.c_str(), cachePath.c_str()) != 0)
+    {
+        std::remove(cachePath.c_str());
+
+        if (std::rename(tempPath.c_str(), cachePath.c_str()) != 0)
+            std::remove(tempPath.c_str());
+    }
+}
+
+bool Charmap::MapImage(std::string cachePath)
+{
+#ifdef _WIN32
+    std::vector<char> data;
+
+    if (!ReadSource(cachePath, data) || data.size() < sizeof(CharmapImageHeader))
+        return false;
+
+    m_ownedImage.assign(data.begin(), data.end());
+    m_image = m_ownedImage.data();
+    m_mappedSize = 0;
+    return true;
+#else
+    int fd = open(cachePath.c_str(), O_RDONLY);
+
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 || (std::size_t)st.st_size < sizeof(CharmapImageHeader))
+    {
+        close(fd);
+        return false;
+    }
+
+    void* image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (image == MAP_FAILED)
+        return false;
+
+    m_image = static_cast<const unsigned char*>(image);
+    m_mappedSize = st.st_size;
+    return true;
+#endif
+}
+
+void Charmap::UnmapImage()
+{
+#ifndef _WIN32
+    if (m_mappedSize != 0)
+        munmap(const_cast<unsigned char*>(m_image), m_mappedSize);
+#endif
+    m_image = NULL;
+    m_mappedSize = 0;
+    m_ownedImage.clear();
+}
+
+void Charmap::UseImage(const unsigned char* image)
+{
+    m_image = image;
+    m_header = reinterpret_cast<const CharmapImageHeader*>(image);
+    m_pageDirectory = reinterpret_cast<const std::uint16_t*>(image + m_header->pageDirectoryOffset);
+    m_pages = reinterpret_cast<const CharmapImageSpan*>(image + m_header->pagesOffset);
+    m_constants = reinterpret_cast<const CharmapImageConstant*>(image + m_header->constantTableOffset);
+}
+
+// When imagePath isn't empty, the compiled charmap is kept there for later
+// runs. The image is reused as long as the source has the same contents it
+// had when the image was compiled. Hashing the source to check that is much
+// cheaper than parsing it.
+Charmap::Charmap(std::string filename, std::string imagePath) : m_image(NULL), m_mappedSize(0)
+{
+    std::vector<char> source;
+
+    if (!ReadSource(filename, source))
+        FATAL_ERROR("Failed to open \"%s\" for reading.\n", filename.c_str());
+
+    std::uint64_t sourceHash = HashBytes(source.data(), source.size());
+
+    if (!imagePath.empty() && MapImage(imagePath))
+    {
+        const CharmapImageHeader* header = reinterpret_cast<const CharmapImageHeader*>(m_image);
+        std::size_t imageSize = m_mappedSize != 0 ? m_mappedSize : m_ownedImage.size();
+        bool valid = std::memcmp(header->magic, kCharmapImageMagic, sizeof(header->magic)) == 0
+                  && header->version == kCharmapImageVersion
+                  && header->imageSize == imageSize
+                  && header->sourceSize == source.size()
+                  && header->sourceHash == sourceHash;
+
+        if (valid)
+        {
+            UseImage(m_image);
+            return;
+        }
+
+        UnmapImage();
+    }
+
+    CompileCharmap(filename, m_ownedImage);
+
+    CharmapImageHeader* header = reinterpret_cast<CharmapImageHeader*>(m_ownedImage.data());
+    header->sourceSize = source.size();
+    header->sourceHash = sourceHash;
+
+    if (!imagePath.empty())
+        WriteCharmapImage(imagePath, m_ownedImage);
+
+    UseImage(m_ownedImage.data());
+}
+
+Charmap::~Charmap()
+{
+    UnmapImage();
+}
+
+CharmapSequence Charmap::Constant(const char* name, std::size_t length)
+{
+    std::uint32_t mask = m_header->constantTableMask;
+    std::uint32_t slot = HashCharmapConstant(name, length) & mask;
+
+    for (;;)
+    {
+        const CharmapImageConstant& constant = m_constants[slot];
+
+        if (constant.name.length == 0)
+            return GetSequence(constant.sequence);
+
+        if (constant.name.length == length && std::memcmp(m_image + constant.name.offset, name, length) == 0)
+            return GetSequence(constant.sequence);
+
+        slot = (slot + 1) & mask;
+    }
 }
@@ -21,44 +21,104 @@
 #ifndef CHARMAP_H
 #define CHARMAP_H
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
 #include <map>
 #include <vector>
 
+// The charmap is compiled into a flat image that can be written to disk and
+// mapped straight back into memory, so later runs don't have to parse the
+// charmap source at all. All offsets are in bytes from the start of the image.
+//
+// Chars are found through a two-level table indexed by code point. The page
+// directory has one entry per 256 code points, and page 0 is left empty so
+// that unmapped ranges need no special case. Constants are kept in an
+// open-addressed hash table.
+
+const std::int32_t kCharmapMaxCode = 0x110000;
+const int kCharmapPageShift = 8;
+const int kCharmapPageSize = 1 << kCharmapPageShift;
+const int kCharmapNumPageDirectoryEntries = kCharmapMaxCode >> kCharmapPageShift;
+
+struct CharmapImageSpan
+{
+    std::uint32_t offset;
+    std::uint32_t length;
+};
+
+struct CharmapImageConstant
+{
+    CharmapImageSpan name;
+    CharmapImageSpan sequence;
+};
+
+struct CharmapImageHeader
+{
+    char magic[4];
+    std::uint32_t version;
+    std::uint64_t sourceSize;
+    std::uint64_t sourceHash;
+    std::uint32_t imageSize;
+    std::uint32_t pageDirectoryOffset;
+    std::uint32_t pagesOffset;
+    std::uint32_t constantTableMask;
+    std::uint32_t constantTableOffset;
+    CharmapImageSpan escapes[128];
+};
+
+// A mapped byte sequence. It points into the charmap image and stays valid for
+// the lifetime of the charmap. An empty sequence means there is no mapping.
+struct CharmapSequence
+{
+    const unsigned char* data;
+    std::size_t length;
+};
+
+std::uint32_t HashCharmapConstant(const char* name, std::size_t length);
+
 class Charmap
 {
 public:
-    Charmap(std::string filename);
+    Charmap(std::string filename, std::string imagePath);
+    Charmap(const Charmap&) = delete;
+    ~Charmap();
 
-    std::string Char(std::int32_t code)
+    CharmapSequence Char(std::int32_t code)
     {
-        auto it = m_chars.find(code);
-
-        if (it == m_chars.end())
-            return std::string();
+        if (code < 0 || code >= kCharmapMaxCode)
+            return GetSequence(m_pages[0]);
 
-        return it->second;
+        std::uint16_t page = m_pageDirectory[code >> kCharmapPageShift];
+        return GetSequence(m_pages[page * kCharmapPageSize + (code & (kCharmapPageSize - 1))]);
     }
 
-    std::string Escape(unsigned char code)
+    CharmapSequence Escape(unsigned char code)
     {
-        return m_escapes[code];
-    }
+        if (code >= 128)
+            return GetSequence(m_pages[0]);
 
-    std::string Constant(std::string identifier)
-    {
-        auto it = m_constants.find(identifier);
+        return GetSequence(m_header->escapes[code]);
+    }
 
-        if (it == m_constants.end())
-            return std::string();
+    CharmapSequence Constant(const char* name, std::size_t length);
+private:
+    const unsigned char* m_image;
+    std::size_t m_mappedSize;
+    std::vector<unsigned char> m_ownedImage;
+    const CharmapImageHeader* m_header;
+    const std::uint16_t* m_pageDirectory;
+    const CharmapImageSpan* m_pages;
+    const CharmapImageConstant* m_constants;
 
-        return it->second;
+    CharmapSequence GetSequence(CharmapImageSpan span)
+    {
+        return { m_image + span.offset, span.length };
     }
-private:
-    std::map<std::int32_t, std::string> m_chars;
-    std::string m_escapes[128];
-    std::map<std::string, std::string> m_constants;
+
+    bool MapImage(std::string cachePath);
+    void UnmapImage();
+    void UseImage(const unsigned char* image);
 };
 
 #endif // CHARMAP_H
@@ -0,0 +1,51 @@
+#include <cstdio>
+#include "preproc.h"
+#include "output_buffer.h"
+
+// Anything still buffered when the program exits, such as the partial output
+// before a fatal error, is written out the same way stdio would have done it.
+OutputBuffer::~OutputBuffer()
+{
+    if (m_length != 0)
+        std::fwrite(m_data, m_length, 1, m_fp);
+}
+
+void OutputBuffer::WriteDecimal(long value)
+{
+    if (value < 0)
+    {
+        Put('-');
+        WriteUnsigned(0UL - (unsigned long)value);
+    }
+    else
+    {
+        WriteUnsigned(value);
+    }
+}
+
+void OutputBuffer::WriteUnsigned(unsigned long value)
+{
+    char s[24];
+    int pos = sizeof(s);
+
+    do
+    {
+        s[--pos] = '0' + (value % 10);
+        value /= 10;
+    } while (value != 0);
+
+    Write(&s[pos], sizeof(s) - pos);
+}
+
+void OutputBuffer::Flush()
+{
+    WriteOut(m_data, m_length);
+    m_length = 0;
+    std::fflush(m_fp);
+}
+
+void OutputBuffer::WriteOut(const char* data, std::size_t length)
+{
+    if (length != 0 && std::fwrite(data, length, 1, m_fp) != 1)
+        FATAL_ERROR("Failed to write output.\n");
+}
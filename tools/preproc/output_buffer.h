@@ -0,0 +1,70 @@
+#ifndef OUTPUT_BUFFER_H
+#define OUTPUT_BUFFER_H
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+// Collects preprocessed output in a large buffer so that it reaches stdout in
+// a few big writes instead of one stdio call per byte or token.
+class OutputBuffer
+{
+public:
+    OutputBuffer(std::FILE* fp) : m_fp(fp), m_length(0) {}
+    OutputBuffer(const OutputBuffer&) = delete;
+    ~OutputBuffer();
+
+    void Put(char c)
+    {
+        if (m_length == kCapacity)
+            Flush();
+
+        m_data[m_length++] = c;
+    }
+
+    void Write(const char* data, std::size_t length)
+    {
+        if (length > kCapacity - m_length)
+        {
+            Flush();
+
+            // Large runs go straight out without being copied.
+            if (length >= kCapacity)
+            {
+                WriteOut(data, length);
+                return;
+            }
+        }
+
+        std::memcpy(&m_data[m_length], data, length);
+        m_length += length;
+    }
+
+    void Write(const char* s)
+    {
+        Write(s, std::strlen(s));
+    }
+
+    // Writes a byte as "0xHH".
+    void WriteHexByte(unsigned char value)
+    {
+        static const char digits[] = "0123456789ABCDEF";
+        char s[4] = { '0', 'x', digits[value >> 4], digits[value & 0xF] };
+        Write(s, sizeof(s));
+    }
+
+    void WriteDecimal(long value);
+    void WriteUnsigned(unsigned long value);
+    void Flush();
+
+private:
+    static const std::size_t kCapacity = 1 << 16;
+
+    std::FILE* m_fp;
+    std::size_t m_length;
+    char m_data[kCapacity];
+
+    void WriteOut(const char* data, std::size_t length);
+};
+
+#endif // OUTPUT_BUFFER_H
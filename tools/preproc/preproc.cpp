@@ -20,26 +20,28 @@
 
 #include <string>
 #include <stack>
+#include <cstdlib>
 #include "preproc.h"
 #include "asm_file.h"
 #include "c_file.h"
 #include "charmap.h"
 
 Charmap* g_charmap;
+OutputBuffer g_output(stdout);
 
 void PrintAsmBytes(unsigned char *s, int length)
 {
     if (length > 0)
     {
-        std::printf("\t.byte ");
+        g_output.Write("\t.byte ");
         for (int i = 0; i < length; i++)
         {
-            std::printf("0x%02X", s[i]);
+            g_output.WriteHexByte(s[i]);
 
             if (i < length - 1)
-                std::printf(", ");
+                g_output.Write(", ", 2);
         }
-        std::putchar('\n');
+        g_output.Put('\n');
     }
 }
 
@@ -89,8 +91,10 @@ void PreprocAsmFile(std::string filename)
 
             if (globalLabel.length() != 0)
             {
-                const char *s = globalLabel.c_str();
-                std::printf("%s: ; .global %s\n", s, s);
+                g_output.Write(globalLabel.c_str(), globalLabel.length());
+                g_output.Write(": ; .global ");
+                g_output.Write(globalLabel.c_str(), globalLabel.length());
+                g_output.Put('\n');
             }
             else
             {
@@ -138,7 +142,9 @@ int main(int argc, char **argv)
         return 1;
     }
 
-    g_charmap = new Charmap(argv[2]);
+    // The build can ask for the compiled charmap to be kept between runs.
+    const char* charmapImage = std::getenv("PREPROC_CHARMAP_IMAGE");
+    g_charmap = new Charmap(argv[2], charmapImage != NULL ? charmapImage : "");
 
     char* extension = GetFileExtension(argv[1]);
 
@@ -152,5 +158,7 @@ int main(int argc, char **argv)
     else
         FATAL_ERROR("\"%s\" has an unknown file extension of \"%s\".\n", argv[1], extension);
 
+    g_output.Flush();
+
     return 0;
 }
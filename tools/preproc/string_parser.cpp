@@ -20,6 +20,7 @@
 
 #include <cstdio>
 #include <cstdarg>
+#include <cstring>
 #include <stdexcept>
 #include "preproc.h"
 #include "string_parser.h"
@@ -27,9 +28,9 @@
 #include "utf8.h"
 
 // Reads a charmap char or escape sequence.
-std::string StringParser::ReadCharOrEscape()
+CharmapSequence StringParser::ReadCharOrEscape()
 {
-    std::string sequence;
+    CharmapSequence sequence;
 
     bool isEscape = (m_buffer[m_pos] == '\\');
 
@@ -41,7 +42,7 @@ std::string StringParser::ReadCharOrEscape()
         {
             sequence = g_charmap->Char('"');
 
-            if (sequence.length() == 0)
+            if (sequence.length == 0)
                 RaiseError("no mapping exists for double quote");
 
             return sequence;
@@ -50,7 +51,7 @@ std::string StringParser::ReadCharOrEscape()
         {
             sequence = g_charmap->Char('\\');
 
-            if (sequence.length() == 0)
+            if (sequence.length == 0)
                 RaiseError("no mapping exists for backslash");
 
             return sequence;
@@ -82,7 +83,7 @@ std::string StringParser::ReadCharOrEscape()
 
     sequence = isEscape ? g_charmap->Escape(code) : g_charmap->Char(code);
 
-    if (sequence.length() == 0)
+    if (sequence.length == 0)
     {
         if (isEscape)
             RaiseError("unknown escape '\\%c'", code);
@@ -94,10 +95,8 @@ std::string StringParser::ReadCharOrEscape()
 }
 
 // Reads a charmap constant, i.e. "{FOO}".
-std::string StringParser::ReadBracketedConstants()
+void StringParser::ReadBracketedConstants(unsigned char* dest, int& destLength)
 {
-    std::string totalSequence;
-
     m_pos++; // Assume we're on the left curly bracket.
 
     while (m_buffer[m_pos] != '}')
@@ -113,36 +112,27 @@ std::string StringParser::ReadBracketedConstants()
             while (IsIdentifierChar(m_buffer[m_pos]))
                 m_pos++;
 
-            std::string sequence = g_charmap->Constant(std::string(&m_buffer[startPos], m_pos - startPos));
+            CharmapSequence sequence = g_charmap->Constant(&m_buffer[startPos], m_pos - startPos);
 
-            if (sequence.length() == 0)
+            if (sequence.length == 0)
             {
-                m_buffer[m_pos] = 0;
-                RaiseError("unknown constant '%s'", &m_buffer[startPos]);
+                RaiseError("unknown constant '%.*s'", (int)(m_pos - startPos), &m_buffer[startPos]);
             }
 
-            totalSequence += sequence;
+            AppendBytes(dest, destLength, sequence.data, sequence.length);
         }
         else if (IsAsciiDigit(m_buffer[m_pos]))
         {
             Integer integer = ReadInteger();
 
-            switch (integer.size)
-            {
-            case 1:
-                totalSequence += (unsigned char)integer.value;
-                break;
-            case 2:
-                totalSequence += (unsigned char)integer.value;
-                totalSequence += (unsigned char)(integer.value >> 8);
-                break;
-            case 4:
-                totalSequence += (unsigned char)integer.value;
-                totalSequence += (unsigned char)(integer.value >> 8);
-                totalSequence += (unsigned char)(integer.value >> 16);
-                totalSequence += (unsigned char)(integer.value >> 24);
-                break;
-            }
+            unsigned char bytes[4] = {
+                (unsigned char)integer.value,
+                (unsigned char)(integer.value >> 8),
+                (unsigned char)(integer.value >> 16),
+                (unsigned char)(integer.value >> 24),
+            };
+
+            AppendBytes(dest, destLength, bytes, integer.size);
         }
         else if (m_buffer[m_pos] == 0)
         {
@@ -161,8 +151,15 @@ std::string StringParser::ReadBracketedConstants()
     }
 
     m_pos++; // Go past the right curly bracket.
+}
+
+void StringParser::AppendBytes(unsigned char* dest, int& destLength, const unsigned char* bytes, std::size_t length)
+{
+    if (length > (std::size_t)(kMaxStringLength - destLength))
+        RaiseError("mapped string longer than %d bytes", kMaxStringLength);
 
-    return totalSequence;
+    std::memcpy(&dest[destLength], bytes, length);
+    destLength += length;
 }
 
 // Reads a charmap string.
@@ -181,14 +178,14 @@ int StringParser::ParseString(long srcPos, unsigned char* dest, int& destLength)
 
     while (m_buffer[m_pos] != '"')
     {
-        std::string sequence = (m_buffer[m_pos] == '{') ? ReadBracketedConstants() : ReadCharOrEscape();
-
-        for (const char& c : sequence)
+        if (m_buffer[m_pos] == '{')
         {
-            if (destLength == kMaxStringLength)
-                RaiseError("mapped string longer than %d bytes", kMaxStringLength);
-
-            dest[destLength++] = c;
+            ReadBracketedConstants(dest, destLength);
+        }
+        else
+        {
+            CharmapSequence sequence = ReadCharOrEscape();
+            AppendBytes(dest, destLength, sequence.data, sequence.length);
         }
     }
 
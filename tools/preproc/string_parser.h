@@ -24,11 +24,12 @@
 #include <cstdint>
 #include <string>
 #include "preproc.h"
+#include "charmap.h"
 
 class StringParser
 {
 public:
-    StringParser(char* buffer, long size) : m_buffer(buffer), m_size(size), m_pos(0) {}
+    StringParser(const char* buffer, long size) : m_buffer(buffer), m_size(size), m_pos(0) {}
     int ParseString(long srcPos, unsigned char* dest, int &destLength);
 
 private:
@@ -38,15 +39,16 @@ private:
         int size;
     };
 
-    char* m_buffer;
+    const char* m_buffer;
     long m_size;
     long m_pos;
 
     Integer ReadInteger();
     Integer ReadDecimal();
     Integer ReadHex();
-    std::string ReadCharOrEscape();
-    std::string ReadBracketedConstants();
+    CharmapSequence ReadCharOrEscape();
+    void ReadBracketedConstants(unsigned char* dest, int& destLength);
+    void AppendBytes(unsigned char* dest, int& destLength, const unsigned char* bytes, std::size_t length);
     void SkipWhitespace();
     void SkipRestOfInteger(int radix);
     void RaiseError(const char* format, ...);
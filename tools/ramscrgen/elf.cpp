@@ -1,272 +1,319 @@
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <cstdint>
-#include <map>
-#include <vector>
 #include <string>
+#include <unordered_map>
+#ifdef _WIN32
+#include <fstream>
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 #include "ramscrgen.h"
 #include "elf.h"
 
 #define SHN_COMMON 0xFFF2
 
-static std::string s_elfPath;
-static std::string s_archiveFilePath;
-static std::string s_archiveObjectPath;
-
-static FILE *s_file;
-
-static std::uint32_t s_sectionHeaderOffset;
-static int s_sectionHeaderEntrySize;
-static int s_sectionCount;
-static int s_shstrtabIndex;
-
-static std::uint32_t s_symtabOffset;
-static std::uint32_t s_strtabOffset;
-
-static std::uint32_t s_symbolCount;
-static std::uint32_t s_elfFileOffset;
-
-struct Symbol
+// An ELF file inside a mapped file. For an archive member, this is just the
+// member's data.
+struct ElfView
 {
-    std::uint32_t nameOffset;
-    std::uint32_t size;
+    const unsigned char *data;
+    std::size_t size;
+    const std::string& path;
 };
 
-static void Seek(long offset)
+static void CheckRange(const ElfView& elf, std::size_t offset, std::size_t length)
 {
-    if (std::fseek(s_file, s_elfFileOffset + offset, SEEK_SET) != 0)
-        FATAL_ERROR("error: failed to seek to %ld in \"%s\"", offset, s_elfPath.c_str());
+    if (offset > elf.size || length > elf.size - offset)
+        FATAL_ERROR("error: unexpected EOF when reading ELF file \"%s\"\n", elf.path.c_str());
 }
 
-static void Skip(long offset)
+static std::uint32_t ReadInt16(const ElfView& elf, std::size_t offset)
 {
-    if (std::fseek(s_file, offset, SEEK_CUR) != 0)
-        FATAL_ERROR("error: failed to skip %ld bytes in \"%s\"", offset, s_elfPath.c_str());
+    CheckRange(elf, offset, 2);
+    const unsigned char *p = elf.data + offset;
+    return p[0] | (p[1] << 8);
 }
 
-static std::uint32_t ReadInt8()
+static std::uint32_t ReadInt32(const ElfView& elf, std::size_t offset)
 {
-    int c = std::fgetc(s_file);
+    CheckRange(elf, offset, 4);
+    const unsigned char *p = elf.data + offset;
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((std::uint32_t)p[3] << 24);
+}
+
+// Returns the string at offset without copying it.
+static const char *GetString(const ElfView& elf, std::size_t offset, std::size_t& length)
+{
+    CheckRange(elf, offset, 0);
+
+    const void *end = std::memchr(elf.data + offset, 0, elf.size - offset);
 
-    if (c < 0)
-        FATAL_ERROR("error: unexpected EOF when reading ELF file \"%s\"\n", s_elfPath.c_str());
+    if (end == nullptr)
+        FATAL_ERROR("error: unexpected EOF when reading ELF file \"%s\"\n", elf.path.c_str());
 
-    return c;
+    length = static_cast<const unsigned char *>(end) - (elf.data + offset);
+    return reinterpret_cast<const char *>(elf.data + offset);
 }
 
-static std::uint32_t ReadInt16()
+static void VerifyElfIdent(const ElfView& elf)
 {
-    std::uint32_t val = 0;
-    val |= ReadInt8();
-    val |= ReadInt8() << 8;
-    return val;
+    const char expectedMagic[4] = { 0x7F, 'E', 'L', 'F' };
+
+    if (elf.size < 6)
+        FATAL_ERROR("error: failed to read ELF magic from \"%s\"\n", elf.path.c_str());
+
+    if (std::memcmp(elf.data, expectedMagic, 4) != 0)
+        FATAL_ERROR("error: ELF magic did not match in \"%s\"\n", elf.path.c_str());
+
+    if (elf.data[4] != 1)
+        FATAL_ERROR("error: \"%s\" not 32-bit ELF\n", elf.path.c_str());
+
+    if (elf.data[5] != 1)
+        FATAL_ERROR("error: \"%s\" not little-endian ELF\n", elf.path.c_str());
 }
 
-static std::uint32_t ReadInt32()
+bool CommonSymbolIndex::SymbolKey::operator==(const SymbolKey& other) const
 {
-    std::uint32_t val = 0;
-    val |= ReadInt8();
-    val |= ReadInt8() << 8;
-    val |= ReadInt8() << 16;
-    val |= ReadInt8() << 24;
-    return val;
+    return object == other.object
+        && length == other.length
+        && std::memcmp(name, other.name, length) == 0;
 }
 
-static std::string ReadString()
+std::size_t CommonSymbolIndex::SymbolKeyHash::operator()(const SymbolKey& key) const
 {
-    std::string s;
-    char c;
+    // FNV-1a
+    std::uint32_t hash = 2166136261u ^ key.object;
 
-    while ((c = ReadInt8()) != 0)
-        s += c;
+    for (std::size_t i = 0; i < key.length; i++)
+    {
+        hash ^= (unsigned char)key.name[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
 
-    return s;
+CommonSymbolIndex::~CommonSymbolIndex()
+{
+#ifndef _WIN32
+    for (auto& entry : m_files)
+    {
+        if (entry.second->mappedSize != 0)
+            munmap(const_cast<unsigned char *>(entry.second->data), entry.second->mappedSize);
+    }
+#endif
 }
 
-static void VerifyElfIdent()
+CommonSymbolIndex::MappedFile& CommonSymbolIndex::MapFile(const std::string& path)
 {
-    char expectedMagic[4] = { 0x7F, 'E', 'L', 'F' };
-    char magic[4];
+    std::unique_ptr<MappedFile>& file = m_files[path];
 
-    if (std::fread(magic, 4, 1, s_file) != 1)
-        FATAL_ERROR("error: failed to read ELF magic from \"%s\"\n", s_elfPath.c_str());
+    if (file)
+        return *file;
 
-    if (std::memcmp(magic, expectedMagic, 4) != 0)
-        FATAL_ERROR("error: ELF magic did not match in \"%s\"\n", s_elfPath.c_str());
+    file.reset(new MappedFile());
 
-    if (std::fgetc(s_file) != 1)
-        FATAL_ERROR("error: \"%s\" not 32-bit ELF\n", s_elfPath.c_str());
+#ifdef _WIN32
+    std::ifstream stream(path, std::ifstream::binary);
 
-    if (std::fgetc(s_file) != 1)
-        FATAL_ERROR("error: \"%s\" not little-endian ELF\n", s_elfPath.c_str());
-}
+    if (!stream.is_open())
+        FATAL_ERROR("error: failed to open \"%s\" for reading\n", path.c_str());
 
-static void VerifyAr()
-{
-    char expectedMagic[8] = {'!', '<', 'a', 'r', 'c', 'h', '>', '\n'};
-    char magic[8];
+    file->buffer.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+    file->data = file->buffer.data();
+    file->size = file->buffer.size();
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
 
-    if (std::fread(magic, 8, 1, s_file) != 1)
-        FATAL_ERROR("error: failed to read AR magic from \"%s\"\n", s_archiveFilePath.c_str());
+    if (fd < 0 || fstat(fd, &st) != 0)
+        FATAL_ERROR("error: failed to open \"%s\" for reading\n", path.c_str());
 
-    if (std::memcmp(magic, expectedMagic, 8) != 0)
-        FATAL_ERROR("error: AR magic did not match in \"%s\"\n", s_archiveFilePath.c_str());
-}
+    if (st.st_size > 0)
+    {
+        void *mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
 
-static void ReadElfHeader()
-{
-    Seek(0x20);
-    s_sectionHeaderOffset = ReadInt32();
-    Seek(0x2E);
-    s_sectionHeaderEntrySize = ReadInt16();
-    s_sectionCount = ReadInt16();
-    s_shstrtabIndex = ReadInt16();
-}
+        if (mapping == MAP_FAILED)
+            FATAL_ERROR("error: failed to read \"%s\"\n", path.c_str());
 
-static void FindArObj()
-{
-    char file_ident[17] = {0};
-    char filesize_s[11] = {0};
-    char expectedEndMagic[2] = { 0x60, 0x0a };
-    char end_magic[2];
-    std::size_t filesize;
-
-    Seek(8);
-    while (!std::feof(s_file)) {
-        if (std::fread(file_ident, 16, 1, s_file) != 1)
-            FATAL_ERROR("error: failed to read file ident in \"%s\"\n", s_archiveFilePath.c_str());
-        Skip(32);
-        if (std::fread(filesize_s, 10, 1, s_file) != 1)
-            FATAL_ERROR("error: failed to read filesize in \"%s\"\n", s_archiveFilePath.c_str());
-        if (std::fread(end_magic, 2, 1, s_file) != 1)
-            FATAL_ERROR("error: failed to read end sentinel in \"%s\"\n", s_archiveFilePath.c_str());
-        if (std::memcmp(end_magic, expectedEndMagic, 2) != 0)
-            FATAL_ERROR("error: corrupted archive header in \"%s\" at \"%s\"\n", s_archiveFilePath.c_str(), file_ident);
-
-        char * ptr = std::strchr(file_ident, '/');
-        if (ptr != nullptr)
-            *ptr = 0;
-        filesize = std::strtoul(filesize_s, nullptr, 10);
-        if (std::strncmp(s_archiveObjectPath.c_str(), file_ident, 16) == 0) {
-            s_elfFileOffset = std::ftell(s_file);
-            return;
-        }
-        Skip(filesize);
+        file->data = static_cast<const unsigned char *>(mapping);
+        file->size = file->mappedSize = st.st_size;
     }
 
-    FATAL_ERROR("error: could not find object \"%s\" in archive \"%s\"\n", s_archiveObjectPath.c_str(), s_archiveFilePath.c_str());
-}
+    close(fd);
+#endif
 
-static std::string GetSectionName(std::uint32_t shstrtabOffset, int index)
-{
-    Seek(s_sectionHeaderOffset + s_sectionHeaderEntrySize * index);
-    std::uint32_t nameOffset = ReadInt32();
-    Seek(shstrtabOffset + nameOffset);
-    return ReadString();
+    return *file;
 }
 
-static void FindTableOffsets()
+std::pair<std::size_t, std::size_t> CommonSymbolIndex::FindArchiveMember(MappedFile& archive, const std::string& archivePath, const std::string& objectName)
 {
-    s_symtabOffset = 0;
-    s_strtabOffset = 0;
+    if (!archive.membersIndexed)
+    {
+        const char expectedMagic[8] = { '!', '<', 'a', 'r', 'c', 'h', '>', '\n' };
+        const char expectedEndMagic[2] = { 0x60, 0x0a };
 
-    Seek(s_sectionHeaderOffset + s_sectionHeaderEntrySize * s_shstrtabIndex + 0x10);
-    std::uint32_t shstrtabOffset = ReadInt32();
+        if (archive.size < 8)
+            FATAL_ERROR("error: failed to read AR magic from \"%s\"\n", archivePath.c_str());
 
-    for (int i = 0; i < s_sectionCount; i++)
-    {
-        std::string name = GetSectionName(shstrtabOffset, i);
+        if (std::memcmp(archive.data, expectedMagic, 8) != 0)
+            FATAL_ERROR("error: AR magic did not match in \"%s\"\n", archivePath.c_str());
 
-        if (name == ".symtab")
-        {
-            if (s_symtabOffset)
-                FATAL_ERROR("error: mutiple .symtab sections found in \"%s\"\n", s_elfPath.c_str());
-            Seek(s_sectionHeaderOffset + s_sectionHeaderEntrySize * i + 0x10);
-            s_symtabOffset = ReadInt32();
-            std::uint32_t size = ReadInt32();
-            s_symbolCount = size / 16;
-        }
-        else if (name == ".strtab")
+        std::size_t offset = 8;
+
+        while (offset < archive.size)
         {
-            if (s_strtabOffset)
-                FATAL_ERROR("error: mutiple .strtab sections found in \"%s\"\n", s_elfPath.c_str());
-            Seek(s_sectionHeaderOffset + s_sectionHeaderEntrySize * i + 0x10);
-            s_strtabOffset = ReadInt32();
+            char file_ident[17] = {0};
+            char filesize_s[11] = {0};
+
+            if (archive.size - offset < 60)
+                FATAL_ERROR("error: failed to read file ident in \"%s\"\n", archivePath.c_str());
+
+            const unsigned char *header = archive.data + offset;
+
+            std::memcpy(file_ident, header, 16);
+            std::memcpy(filesize_s, header + 48, 10);
+
+            if (std::memcmp(header + 58, expectedEndMagic, 2) != 0)
+                FATAL_ERROR("error: corrupted archive header in \"%s\" at \"%s\"\n", archivePath.c_str(), file_ident);
+
+            char * ptr = std::strchr(file_ident, '/');
+            if (ptr != nullptr)
+                *ptr = 0;
+            std::size_t filesize = std::strtoul(filesize_s, nullptr, 10);
+            offset += 60;
+
+            if (filesize > archive.size - offset)
+                FATAL_ERROR("error: truncated object \"%s\" in archive \"%s\"\n", file_ident, archivePath.c_str());
+
+            // The first member with a name wins, as it does for the linker.
+            archive.members.emplace(file_ident, std::make_pair(offset, filesize));
+
+            // Members are padded to an even offset.
+            offset += filesize + (filesize & 1);
         }
+
+        archive.membersIndexed = true;
     }
 
-    if (!s_symtabOffset)
-        FATAL_ERROR("error: couldn't find .symtab section in \"%s\"\n", s_elfPath.c_str());
+    auto it = archive.members.find(objectName.substr(0, 16));
+
+    if (it == archive.members.end())
+        FATAL_ERROR("error: could not find object \"%s\" in archive \"%s\"\n", objectName.c_str(), archivePath.c_str());
 
-    if (!s_strtabOffset)
-        FATAL_ERROR("error: couldn't find .strtab section in \"%s\"\n", s_elfPath.c_str());
+    return it->second;
 }
 
-static std::map<std::string, std::uint32_t> GetCommonSymbols_Shared()
+void CommonSymbolIndex::ReadCommonSymbols(int object, const unsigned char *data, std::size_t size, const std::string& elfPath)
 {
-    VerifyElfIdent();
-    ReadElfHeader();
-    FindTableOffsets();
+    ElfView elf = { data, size, elfPath };
 
-    std::map<std::string, std::uint32_t> commonSymbols;
+    VerifyElfIdent(elf);
 
-    std::vector<Symbol> commonSymbolVec;
+    std::size_t sectionHeaderOffset = ReadInt32(elf, 0x20);
+    std::size_t sectionHeaderEntrySize = ReadInt16(elf, 0x2E);
+    std::size_t sectionCount = ReadInt16(elf, 0x30);
+    std::size_t shstrtabIndex = ReadInt16(elf, 0x32);
 
-    Seek(s_symtabOffset);
+    std::size_t shstrtabOffset = ReadInt32(elf, sectionHeaderOffset + sectionHeaderEntrySize * shstrtabIndex + 0x10);
+    std::size_t symtabOffset = 0;
+    std::size_t strtabOffset = 0;
+    std::size_t symbolCount = 0;
 
-    for (std::uint32_t i = 0; i < s_symbolCount; i++)
+    for (std::size_t i = 0; i < sectionCount; i++)
     {
-        Symbol sym;
-        sym.nameOffset = ReadInt32();
-        Skip(4);
-        sym.size = ReadInt32();
-        Skip(2);
-        std::uint16_t sectionIndex = ReadInt16();
-        if (sectionIndex == SHN_COMMON)
-            commonSymbolVec.push_back(sym);
+        std::size_t sectionHeader = sectionHeaderOffset + sectionHeaderEntrySize * i;
+        std::size_t length;
+        const char *name = GetString(elf, shstrtabOffset + ReadInt32(elf, sectionHeader), length);
+
+        if (length == 7 && std::memcmp(name, ".symtab", 7) == 0)
+        {
+            if (symtabOffset)
+                FATAL_ERROR("error: mutiple .symtab sections found in \"%s\"\n", elfPath.c_str());
+            symtabOffset = ReadInt32(elf, sectionHeader + 0x10);
+            symbolCount = ReadInt32(elf, sectionHeader + 0x14) / 16;
+        }
+        else if (length == 7 && std::memcmp(name, ".strtab", 7) == 0)
+        {
+            if (strtabOffset)
+                FATAL_ERROR("error: mutiple .strtab sections found in \"%s\"\n", elfPath.c_str());
+            strtabOffset = ReadInt32(elf, sectionHeader + 0x10);
+        }
     }
 
-    for (const Symbol& sym : commonSymbolVec)
+    if (!symtabOffset)
+        FATAL_ERROR("error: couldn't find .symtab section in \"%s\"\n", elfPath.c_str());
+
+    if (!strtabOffset)
+        FATAL_ERROR("error: couldn't find .strtab section in \"%s\"\n", elfPath.c_str());
+
+    CheckRange(elf, symtabOffset, symbolCount * 16);
+
+    for (std::size_t i = 0; i < symbolCount; i++)
     {
-        Seek(s_strtabOffset + sym.nameOffset);
-        std::string name = ReadString();
-        commonSymbols[name] = sym.size;
-    }
+        std::size_t symbol = symtabOffset + 16 * i;
+
+        if (ReadInt16(elf, symbol + 14) != SHN_COMMON)
+            continue;
 
-    return commonSymbols;
+        SymbolKey key;
+        key.object = object;
+        key.name = GetString(elf, strtabOffset + ReadInt32(elf, symbol), key.length);
+        m_symbols[key] = ReadInt32(elf, symbol + 8);
+    }
 }
 
-std::map<std::string, std::uint32_t> GetCommonSymbolsFromLib(std::string sourcePath, std::string libpath)
+int CommonSymbolIndex::AddObject(const std::string& sourcePath, const std::string& path)
 {
-    std::size_t colonPos = libpath.find(':');
-    if (colonPos == std::string::npos)
-        FATAL_ERROR("error: missing colon separator in libfile \"%s\"\n", s_elfPath.c_str());
+    auto it = m_objects.find(sourcePath + "/" + path);
+
+    if (it != m_objects.end())
+        return it->second;
 
-    s_archiveObjectPath = libpath.substr(colonPos + 1);
-    s_archiveFilePath = sourcePath + "/" + libpath.substr(1, colonPos - 1);
-    s_elfPath = sourcePath + "/" + libpath.substr(1);
+    int object = m_objects.size();
+    m_objects.emplace(sourcePath + "/" + path, object);
 
-    s_file = std::fopen(s_archiveFilePath.c_str(), "rb");
+    if (path[0] == '*')
+    {
+        std::size_t colonPos = path.find(':');
+        if (colonPos == std::string::npos)
+            FATAL_ERROR("error: missing colon separator in libfile \"%s\"\n", path.c_str());
 
-    if (s_file == NULL)
-        FATAL_ERROR("error: failed to open \"%s\" for reading\n", s_archiveFilePath.c_str());
+        std::string archiveFilePath = sourcePath + "/" + path.substr(1, colonPos - 1);
+        std::string elfPath = sourcePath + "/" + path.substr(1);
+
+        MappedFile& archive = MapFile(archiveFilePath);
+        std::pair<std::size_t, std::size_t> member = FindArchiveMember(archive, archiveFilePath, path.substr(colonPos + 1));
+        ReadCommonSymbols(object, archive.data + member.first, member.second, elfPath);
+    }
+    else
+    {
+        std::string elfPath = sourcePath + "/" + path;
+        MappedFile& file = MapFile(elfPath);
+        ReadCommonSymbols(object, file.data, file.size, elfPath);
+    }
 
-    VerifyAr();
-    FindArObj();
-    return GetCommonSymbols_Shared();
+    return object;
 }
 
-std::map<std::string, std::uint32_t> GetCommonSymbols(std::string sourcePath, std::string path)
+bool CommonSymbolIndex::FindSymbol(int object, const std::string& name, std::uint32_t& size) const
 {
-    s_elfFileOffset = 0;
-    if (path[0] == '*')
-        return GetCommonSymbolsFromLib(sourcePath, path);
+    SymbolKey key;
+    key.object = object;
+    key.name = name.c_str();
+    key.length = name.length();
 
-    s_elfPath = sourcePath + "/" + path;
-    s_file = std::fopen(s_elfPath.c_str(), "rb");
+    auto it = m_symbols.find(key);
 
-    if (s_file == NULL)
-        FATAL_ERROR("error: failed to open \"%s\" for reading\n", path.c_str());
+    if (it == m_symbols.end())
+        return false;
 
-    return GetCommonSymbols_Shared();
+    size = it->second;
+    return true;
 }
@@ -21,10 +21,65 @@
 #ifndef ELF_H
 #define ELF_H
 
+#include <cstddef>
 #include <cstdint>
-#include <map>
+#include <memory>
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
-std::map<std::string, std::uint32_t> GetCommonSymbols(std::string sourcePath, std::string path);
+// The COMMON symbols of every object file read so far, in one hash table.
+// Each file is memory-mapped once and symbol names point into the mapping,
+// so reading an object doesn't copy any of its strings.
+class CommonSymbolIndex
+{
+public:
+    CommonSymbolIndex() = default;
+    CommonSymbolIndex(const CommonSymbolIndex&) = delete;
+    CommonSymbolIndex& operator=(const CommonSymbolIndex&) = delete;
+    ~CommonSymbolIndex();
+
+    // Reads the COMMON symbols of an object file under sourcePath, or of an
+    // object in an archive if path is "*ARCHIVE:OBJECT". Returns an id to
+    // pass to FindSymbol. Reading the same path again returns the same id.
+    int AddObject(const std::string& sourcePath, const std::string& path);
+
+    bool FindSymbol(int object, const std::string& name, std::uint32_t& size) const;
+
+private:
+    struct MappedFile
+    {
+        const unsigned char *data = nullptr;
+        std::size_t size = 0;
+        std::size_t mappedSize = 0;
+        std::vector<unsigned char> buffer;
+        // For archives, each member's data by name.
+        std::unordered_map<std::string, std::pair<std::size_t, std::size_t>> members;
+        bool membersIndexed = false;
+    };
+
+    struct SymbolKey
+    {
+        int object;
+        const char *name;
+        std::size_t length;
+
+        bool operator==(const SymbolKey& other) const;
+    };
+
+    struct SymbolKeyHash
+    {
+        std::size_t operator()(const SymbolKey& key) const;
+    };
+
+    std::unordered_map<std::string, std::unique_ptr<MappedFile>> m_files;
+    std::unordered_map<std::string, int> m_objects;
+    std::unordered_map<SymbolKey, std::uint32_t, SymbolKeyHash> m_symbols;
+
+    MappedFile& MapFile(const std::string& path);
+    std::pair<std::size_t, std::size_t> FindArchiveMember(MappedFile& archive, const std::string& archivePath, const std::string& objectName);
+    void ReadCommonSymbols(int object, const unsigned char *data, std::size_t size, const std::string& elfPath);
+};
 
 #endif // ELF_H
@@ -25,9 +25,9 @@
 #include "sym_file.h"
 #include "elf.h"
 
-void HandleCommonInclude(std::string filename, std::string sourcePath, std::string symOrderPath, std::string lang)
+void HandleCommonInclude(CommonSymbolIndex& commonSymbols, std::string filename, std::string sourcePath, std::string symOrderPath, std::string lang)
 {
-    auto commonSymbols = GetCommonSymbols(sourcePath, filename);
+    int object = commonSymbols.AddObject(sourcePath, filename);
     std::size_t dotIndex;
 
     if (filename[0] == '*') {
@@ -62,9 +62,9 @@ void HandleCommonInclude(std::string filename, std::string sourcePath, std::stri
         }
         else
         {
-            if (commonSymbols.count(label) == 0)
+            std::uint32_t size;
+            if (!commonSymbols.FindSymbol(object, label, size))
                 symFile.RaiseError("no common symbol named \"%s\"", label.c_str());
-            unsigned long size = commonSymbols[label];
             int alignment = 4;
             if (size > 4)
                 alignment = 8;
@@ -72,7 +72,7 @@ void HandleCommonInclude(std::string filename, std::string sourcePath, std::stri
                 alignment = 16;
             printf(". = ALIGN(%d);\n", alignment);
             printf("%s = .;\n", label.c_str());
-            printf(". += 0x%lX;\n", size);
+            printf(". += 0x%lX;\n", (unsigned long)size);
         }
 
         symFile.ExpectEmptyRestOfLine();
@@ -82,6 +82,7 @@ void HandleCommonInclude(std::string filename, std::string sourcePath, std::stri
 void ConvertSymFile(std::string filename, std::string sectionName, std::string lang, bool common, std::string sourcePath, std::string commonSymPath, std::string libSourcePath)
 {
     SymFile symFile(filename);
+    CommonSymbolIndex commonSymbols;
 
     while (!symFile.IsAtEnd())
     {
@@ -97,7 +98,7 @@ void ConvertSymFile(std::string filename, std::string sectionName, std::string l
             symFile.ExpectEmptyRestOfLine();
             printf(". = ALIGN(4);\n");
             if (common)
-                HandleCommonInclude(incFilename, incFilename[0] == '*' ? libSourcePath : sourcePath, commonSymPath, lang);
+                HandleCommonInclude(commonSymbols, incFilename, incFilename[0] == '*' ? libSourcePath : sourcePath, commonSymPath, lang);
             else
                 printf("%s(%s);\n", incFilename.c_str(), sectionName.c_str());
             break;
@@ -21,6 +21,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <list>
+#include <map>
 #include <queue>
 #include <set>
 #include <string>
@@ -29,31 +30,184 @@
 
 bool CanOpenFile(std::string path)
 {
+    // Sources that share headers probe the same paths over and over, so
+    // remember the answer for every path that was tried.
+    static std::map<std::string, bool> s_results;
+
+    auto it = s_results.find(path);
+
+    if (it != s_results.end())
+        return it->second;
+
     FILE *fp = std::fopen(path.c_str(), "rb");
+    bool canOpen = (fp != NULL);
+
+    if (canOpen)
+        std::fclose(fp);
+
+    s_results[path] = canOpen;
+    return canOpen;
+}
+
+const char *const USAGE = "Usage: scaninc [-I INCLUDE_PATH] [-M [-MP] [-MT TARGET] [-MF DEP_FILE]] FILE_PATH\n";
+
+struct Dependencies
+{
+    // Everything the file depends on, in the order it is listed without -M.
+    std::set<std::string> all;
+    // Included files, whether or not they exist yet.
+    std::set<std::string> includes;
+    // Included files that exist and were scanned in turn.
+    std::set<std::string> headers;
+};
+
+Dependencies ScanDependencies(std::string initialPath, std::vector<std::string> includeDirs)
+{
+    std::queue<std::string> filesToProcess;
+    Dependencies dependencies;
+
+    filesToProcess.push(initialPath);
+
+    while (!filesToProcess.empty())
+    {
+        std::string filePath = filesToProcess.front();
+        SourceFile file(filePath);
+        filesToProcess.pop();
+
+        includeDirs.push_back(file.GetSrcDir());
+        for (auto incbin : file.GetIncbins())
+        {
+            dependencies.all.insert(incbin);
+        }
+        for (auto include : file.GetIncludes())
+        {
+            bool exists = false;
+            std::string path("");
+            for (auto includeDir : includeDirs)
+            {
+                path = includeDir + include;
+                if (CanOpenFile(path))
+                {
+                    exists = true;
+                    break;
+                }
+            }
+            if (!exists && file.FileType() == SourceFileType::Asm)
+            {
+                path = include;
+            }
+            bool inserted = dependencies.all.insert(path).second;
+            if (inserted)
+            {
+                dependencies.includes.insert(path);
+            }
+            if (inserted && exists)
+            {
+                dependencies.headers.insert(path);
+                filesToProcess.push(path);
+            }
+        }
+        includeDirs.pop_back();
+    }
+
+    return dependencies;
+}
+
+void WriteRule(FILE *fp, std::string targets, const std::set<std::string>& prerequisites)
+{
+    std::fprintf(fp, "%s:", targets.c_str());
+    for (const std::string &path : prerequisites)
+    {
+        std::fprintf(fp, " \\\n %s", path.c_str());
+    }
+    std::fprintf(fp, "\n");
+}
+
+// Writes the dependencies in the format of GCC's -M option. When a dependency
+// file is given, it is made a target of the included files too, so that it
+// gets regenerated whenever one of them changes and might include new files.
+// Incbins only matter to the object. With phonyTargets, every header also
+// gets an empty rule so that deleting it doesn't break the build.
+void WriteDepRules(FILE *fp, std::string target, std::string depFilePath, const Dependencies& dependencies, bool phonyTargets)
+{
+    std::set<std::string> incbins;
+
+    for (const std::string &path : dependencies.all)
+    {
+        if (dependencies.includes.count(path) == 0)
+            incbins.insert(path);
+    }
+
+    if (depFilePath.empty())
+    {
+        WriteRule(fp, target, dependencies.all);
+    }
+    else
+    {
+        WriteRule(fp, target + " " + depFilePath, dependencies.includes);
+        if (!incbins.empty())
+            WriteRule(fp, target, incbins);
+    }
+
+    if (phonyTargets)
+    {
+        for (const std::string &path : dependencies.headers)
+        {
+            std::fprintf(fp, "\n%s:\n", path.c_str());
+        }
+    }
+}
+
+void WriteDepFile(std::string depFilePath, std::string target, const Dependencies& dependencies, bool phonyTargets)
+{
+    FILE *fp = std::fopen(depFilePath.c_str(), "wb");
 
     if (fp == NULL)
-        return false;
+        FATAL_ERROR("Failed to open \"%s\" for writing.\n", depFilePath.c_str());
+
+    WriteDepRules(fp, target, depFilePath, dependencies, phonyTargets);
 
     std::fclose(fp);
-    return true;
 }
 
-const char *const USAGE = "Usage: scaninc [-I INCLUDE_PATH] FILE_PATH\n";
+std::string ReplaceExtension(std::string path, std::string extension)
+{
+    std::size_t dot = path.find_last_of('.');
+    return path.substr(0, dot) + extension;
+}
 
 int main(int argc, char **argv)
 {
-    std::queue<std::string> filesToProcess;
-    std::set<std::string> dependencies;
-
     std::vector<std::string> includeDirs;
+    bool makeRules = false;
+    bool phonyTargets = false;
+    std::string target;
+    std::string depFilePath;
 
     argc--;
     argv++;
 
-    while (argc > 1)
+    while (argc > 1 && argv[0][0] == '-')
     {
         std::string arg(argv[0]);
-        if (arg.substr(0, 2) == "-I")
+        if (arg == "-M")
+        {
+            makeRules = true;
+        }
+        else if (arg == "-MP")
+        {
+            phonyTargets = true;
+        }
+        else if (arg == "-MT" || arg == "-MF")
+        {
+            argc--;
+            argv++;
+            if (arg == "-MT")
+                target = std::string(argv[0]);
+            else
+                depFilePath = std::string(argv[0]);
+        }
+        else if (arg.substr(0, 2) == "-I")
         {
             std::string includeDir = arg.substr(2);
             if (includeDir.empty())
@@ -80,49 +234,26 @@ int main(int argc, char **argv)
         FATAL_ERROR(USAGE);
     }
 
-    std::string initialPath(argv[0]);
+    if (makeRules)
+    {
+        std::string sourcePath(argv[0]);
+        Dependencies dependencies = ScanDependencies(sourcePath, includeDirs);
 
-    filesToProcess.push(initialPath);
+        if (target.empty())
+            target = ReplaceExtension(sourcePath.substr(sourcePath.find_last_of('/') + 1), ".o");
 
-    while (!filesToProcess.empty())
+        if (depFilePath.empty())
+            WriteDepRules(stdout, target, depFilePath, dependencies, phonyTargets);
+        else
+            WriteDepFile(depFilePath, target, dependencies, phonyTargets);
+    }
+    else
     {
-        std::string filePath = filesToProcess.front();
-        SourceFile file(filePath);
-        filesToProcess.pop();
+        Dependencies dependencies = ScanDependencies(std::string(argv[0]), includeDirs);
 
-        includeDirs.push_back(file.GetSrcDir());
-        for (auto incbin : file.GetIncbins())
+        for (const std::string &path : dependencies.all)
         {
-            dependencies.insert(incbin);
-        }
-        for (auto include : file.GetIncludes())
-        {
-            bool exists = false;
-            std::string path("");
-            for (auto includeDir : includeDirs)
-            {
-                path = includeDir + include;
-                if (CanOpenFile(path))
-                {
-                    exists = true;
-                    break;
-                }
-            }
-            if (!exists && file.FileType() == SourceFileType::Asm)
-            {
-                path = include;
-            }
-            bool inserted = dependencies.insert(path).second;
-            if (inserted && exists)
-            {
-                filesToProcess.push(path);
-            }
+            std::printf("%s\n", path.c_str());
         }
-        includeDirs.pop_back();
-    }
-
-    for (const std::string &path : dependencies)
-    {
-        std::printf("%s\n", path.c_str());
     }
 }
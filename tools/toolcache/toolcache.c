@@ -0,0 +1,630 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#define mkdir(path, mode) _mkdir(path)
+#endif
+#include "toolcache.h"
+
+// The cache directory holds two kinds of files, both named by a digest and
+// spread over subdirectories named by the digest's first two digits:
+//
+//   <key>.manifest   one per run, listing its outputs and the inputs it found
+//                    while running:
+//                        input <digest> <path>
+//                        output <digest> <path>
+//   <digest>         an output's contents
+//
+// Everything is written to a temporary file and renamed into place, so
+// concurrent runs never see a partial file.
+
+#define DIGEST_HEX_SIZE 33
+
+struct CacheFile {
+    char *path;
+    char *tempPath;
+    char digest[DIGEST_HEX_SIZE];
+};
+
+struct ToolCache {
+    // NULL when caching is off.
+    char *dir;
+    // The executable's digest, the arguments and the inputs added before
+    // ToolCacheRestore, separated by NULs.
+    char *key;
+    size_t keySize;
+    size_t keyCapacity;
+    char keyDigest[DIGEST_HEX_SIZE];
+    bool keyed;
+    bool restored;
+    struct CacheFile *inputs;
+    int numInputs;
+    struct CacheFile *outputs;
+    int numOutputs;
+};
+
+// The cache whose temporary outputs are removed if the tool exits before
+// ToolCacheFinish, as it does on an error.
+static struct ToolCache *sPendingCache;
+
+static void *Allocate(size_t size)
+{
+    void *p = malloc(size);
+
+    if (p == NULL)
+    {
+        fprintf(stderr, "Failed to allocate memory for the tool cache.\n");
+        exit(1);
+    }
+
+    return p;
+}
+
+static char *Concat(const char *a, const char *b, const char *c)
+{
+    size_t aLength = strlen(a);
+    size_t bLength = strlen(b);
+    size_t cLength = strlen(c);
+    char *s = (char *)Allocate(aLength + bLength + cLength + 1);
+
+    memcpy(s, a, aLength);
+    memcpy(s + aLength, b, bLength);
+    memcpy(s + aLength + bLength, c, cLength + 1);
+    return s;
+}
+
+static uint64_t Rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t Fmix64(uint64_t k)
+{
+    k ^= k >> 33;
+    k *= 0xFF51AFD7ED558CCDULL;
+    k ^= k >> 33;
+    k *= 0xC4CEB9FE1A85EC53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+static uint64_t ReadLE64(const unsigned char *p)
+{
+    uint64_t val = 0;
+
+    for (int i = 7; i >= 0; i--)
+        val = (val << 8) | p[i];
+
+    return val;
+}
+
+// MurmurHash3_x64_128 by Austin Appleby, written out as a hex string.
+static void HashData(const void *data, size_t size, char *digest)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    const uint64_t c1 = 0x87C37B91114253D5ULL;
+    const uint64_t c2 = 0x4CF5AD432745937FULL;
+    uint64_t h1 = 0;
+    uint64_t h2 = 0;
+    size_t numBlocks = size / 16;
+
+    for (size_t i = 0; i < numBlocks; i++)
+    {
+        uint64_t k1 = ReadLE64(bytes + i * 16);
+        uint64_t k2 = ReadLE64(bytes + i * 16 + 8);
+
+        k1 *= c1; k1 = Rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+        h1 = Rotl64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52DCE729;
+        k2 *= c2; k2 = Rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+        h2 = Rotl64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495AB5;
+    }
+
+    const unsigned char *tail = bytes + numBlocks * 16;
+    size_t tailSize = size & 15;
+    uint64_t k1 = 0;
+    uint64_t k2 = 0;
+
+    for (size_t i = tailSize; i > 8; i--)
+        k2 ^= (uint64_t)tail[i - 1] << ((i - 9) * 8);
+
+    if (tailSize > 8)
+    {
+        k2 *= c2; k2 = Rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+    }
+
+    for (size_t i = tailSize < 8 ? tailSize : 8; i > 0; i--)
+        k1 ^= (uint64_t)tail[i - 1] << ((i - 1) * 8);
+
+    if (tailSize > 0)
+    {
+        k1 *= c1; k1 = Rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+    }
+
+    h1 ^= size;
+    h2 ^= size;
+    h1 += h2;
+    h2 += h1;
+    h1 = Fmix64(h1);
+    h2 = Fmix64(h2);
+    h1 += h2;
+    h2 += h1;
+
+    snprintf(digest, DIGEST_HEX_SIZE, "%016llx%016llx", (unsigned long long)h1, (unsigned long long)h2);
+}
+
+// Returns the contents of a file followed by a NUL, or NULL if it can't be read.
+static unsigned char *ReadFile(const char *path, size_t *size)
+{
+    FILE *fp = fopen(path, "rb");
+
+    if (fp == NULL)
+        return NULL;
+
+    fseek(fp, 0, SEEK_END);
+    long length = ftell(fp);
+    rewind(fp);
+
+    if (length < 0)
+    {
+        fclose(fp);
+        return NULL;
+    }
+
+    unsigned char *data = (unsigned char *)Allocate(length + 1);
+
+    if (length > 0 && fread(data, length, 1, fp) != 1)
+    {
+        free(data);
+        fclose(fp);
+        return NULL;
+    }
+
+    fclose(fp);
+    data[length] = 0;
+    *size = length;
+    return data;
+}
+
+static bool HashFile(const char *path, char *digest)
+{
+    size_t size;
+    unsigned char *data = ReadFile(path, &size);
+
+    if (data == NULL)
+        return false;
+
+    HashData(data, size, digest);
+    free(data);
+    return true;
+}
+
+static bool ReplaceFile(const char *tempPath, const char *path)
+{
+#ifdef _WIN32
+    // rename() won't overwrite an existing file on Windows.
+    remove(path);
+#endif
+    return rename(tempPath, path) == 0;
+}
+
+static bool WriteFileAtomically(const char *path, const char *tempPath, const void *data, size_t size)
+{
+    FILE *fp = fopen(tempPath, "wb");
+
+    if (fp == NULL)
+        return false;
+
+    bool ok = size == 0 || fwrite(data, size, 1, fp) == 1;
+
+    if (fclose(fp) != 0)
+        ok = false;
+
+    if (ok && ReplaceFile(tempPath, path))
+        return true;
+
+    remove(tempPath);
+    return false;
+}
+
+// Returns the path to write an output to before it replaces path. It's in the
+// same directory, so the rename can't cross file systems, and keeps the file
+// extension, which some tools use to pick a conversion.
+static char *GetTempPath(const char *path)
+{
+    const char *name = strrchr(path, '/');
+#ifdef _WIN32
+    const char *backslash = strrchr(path, '\\');
+
+    if (backslash != NULL && (name == NULL || backslash > name))
+        name = backslash;
+#endif
+    name = (name == NULL) ? path : name + 1;
+
+    size_t dirLength = name - path;
+    char *tempPath = (char *)Allocate(strlen(path) + sizeof(".tmp."));
+
+    memcpy(tempPath, path, dirLength);
+    strcpy(tempPath + dirLength, ".tmp.");
+    strcat(tempPath, name);
+    return tempPath;
+}
+
+static void MakeDirectories(char *path)
+{
+    for (char *p = path + 1; *p != 0; p++)
+    {
+        if (*p == '/')
+        {
+            *p = 0;
+            mkdir(path, 0777);
+            *p = '/';
+        }
+    }
+
+    mkdir(path, 0777);
+}
+
+static char *GetCacheSubdir(const struct ToolCache *cache, const char *digest)
+{
+    char subdir[4] = { '/', digest[0], digest[1], 0 };
+
+    return Concat(cache->dir, subdir, "");
+}
+
+static char *GetCachePath(const struct ToolCache *cache, const char *digest, const char *suffix)
+{
+    char *subdir = GetCacheSubdir(cache, digest);
+    char *name = Concat("/", digest, suffix);
+    char *path = Concat(subdir, name, "");
+
+    free(subdir);
+    free(name);
+    return path;
+}
+
+static void AddKey(struct ToolCache *cache, const char *s)
+{
+    size_t length = strlen(s) + 1;
+
+    if (cache->keySize + length > cache->keyCapacity)
+    {
+        cache->keyCapacity = (cache->keySize + length) * 2;
+        cache->key = (char *)realloc(cache->key, cache->keyCapacity);
+
+        if (cache->key == NULL)
+        {
+            fprintf(stderr, "Failed to allocate memory for the tool cache.\n");
+            exit(1);
+        }
+    }
+
+    memcpy(cache->key + cache->keySize, s, length);
+    cache->keySize += length;
+}
+
+static void DisableCache(struct ToolCache *cache)
+{
+    free(cache->dir);
+    cache->dir = NULL;
+}
+
+static struct CacheFile *AddFile(struct CacheFile **files, int *numFiles, const char *path)
+{
+    *files = (struct CacheFile *)realloc(*files, (*numFiles + 1) * sizeof(struct CacheFile));
+
+    if (*files == NULL)
+    {
+        fprintf(stderr, "Failed to allocate memory for the tool cache.\n");
+        exit(1);
+    }
+
+    struct CacheFile *file = &(*files)[(*numFiles)++];
+
+    file->path = Concat(path, "", "");
+    file->tempPath = NULL;
+    file->digest[0] = 0;
+    return file;
+}
+
+struct ToolCache *ToolCacheBegin(int argc, char **argv)
+{
+    struct ToolCache *cache = (struct ToolCache *)Allocate(sizeof(struct ToolCache));
+    const char *dir = getenv("TOOLS_CACHE_DIR");
+    char exeDigest[DIGEST_HEX_SIZE];
+
+    memset(cache, 0, sizeof(struct ToolCache));
+
+    if (dir == NULL || *dir == 0)
+        return cache;
+
+    // Outputs can only be reused if they came from this exact build of the tool.
+    if (!HashFile(argv[0], exeDigest))
+    {
+#ifdef _WIN32
+        char *exePath = Concat(argv[0], ".exe", "");
+        bool found = HashFile(exePath, exeDigest);
+
+        free(exePath);
+
+        if (!found)
+            return cache;
+#else
+        return cache;
+#endif
+    }
+
+    cache->dir = Concat(dir, "", "");
+    AddKey(cache, "toolcache 1");
+    AddKey(cache, exeDigest);
+
+    for (int i = 1; i < argc; i++)
+        AddKey(cache, argv[i]);
+
+    return cache;
+}
+
+void ToolCacheAddInput(struct ToolCache *cache, const char *path)
+{
+    char digest[DIGEST_HEX_SIZE];
+
+    if (cache->dir == NULL)
+        return;
+
+    // The tool reports a missing input itself.
+    if (!HashFile(path, digest))
+    {
+        DisableCache(cache);
+        return;
+    }
+
+    if (!cache->keyed)
+    {
+        AddKey(cache, path);
+        AddKey(cache, digest);
+    }
+    else
+    {
+        strcpy(AddFile(&cache->inputs, &cache->numInputs, path)->digest, digest);
+    }
+}
+
+// Checks that every input listed in a manifest is unchanged and every output
+// is in the cache, then moves the outputs into place.
+static bool RestoreOutputs(struct ToolCache *cache, char *manifest)
+{
+    for (int pass = 0; pass < 2; pass++)
+    {
+        char *line = manifest;
+
+        while (*line != 0)
+        {
+            char *end = strchr(line, '\n');
+
+            if (end == NULL)
+                return false;
+
+            *end = 0;
+
+            char *digest = strchr(line, ' ');
+            char *path = (digest == NULL) ? NULL : strchr(digest + 1, ' ');
+
+            if (path == NULL || path - digest != DIGEST_HEX_SIZE)
+                return false;
+
+            *digest++ = 0;
+            *path++ = 0;
+
+            if (strcmp(line, "input") == 0)
+            {
+                char inputDigest[DIGEST_HEX_SIZE];
+
+                if (pass == 0 && (!HashFile(path, inputDigest) || strcmp(inputDigest, digest) != 0))
+                    return false;
+            }
+            else if (strcmp(line, "output") == 0)
+            {
+                char *blobPath = GetCachePath(cache, digest, "");
+                size_t size;
+                unsigned char *data = ReadFile(blobPath, &size);
+                char dataDigest[DIGEST_HEX_SIZE];
+                bool ok = data != NULL;
+
+                free(blobPath);
+
+                if (ok)
+                {
+                    HashData(data, size, dataDigest);
+                    ok = strcmp(dataDigest, digest) == 0;
+                }
+
+                if (ok && pass == 1)
+                {
+                    char *tempPath = GetTempPath(path);
+
+                    ok = WriteFileAtomically(path, tempPath, data, size);
+                    free(tempPath);
+                }
+
+                free(data);
+
+                if (!ok)
+                    return false;
+            }
+            else
+            {
+                return false;
+            }
+
+            // Undo the splitting so the next pass can read the line again.
+            digest[-1] = ' ';
+            path[-1] = ' ';
+            *end = '\n';
+            line = end + 1;
+        }
+    }
+
+    return true;
+}
+
+bool ToolCacheRestore(struct ToolCache *cache)
+{
+    if (cache->dir == NULL)
+        return false;
+
+    cache->keyed = true;
+    HashData(cache->key, cache->keySize, cache->keyDigest);
+
+    char *manifestPath = GetCachePath(cache, cache->keyDigest, ".manifest");
+    size_t size;
+    char *manifest = (char *)ReadFile(manifestPath, &size);
+
+    free(manifestPath);
+
+    if (manifest == NULL)
+        return false;
+
+    cache->restored = RestoreOutputs(cache, manifest);
+    free(manifest);
+    return cache->restored;
+}
+
+static void RemovePendingOutputs(void)
+{
+    if (sPendingCache == NULL)
+        return;
+
+    for (int i = 0; i < sPendingCache->numOutputs; i++)
+        remove(sPendingCache->outputs[i].tempPath);
+}
+
+const char *ToolCacheAddOutput(struct ToolCache *cache, const char *path)
+{
+    static bool registered;
+
+    if (!registered)
+    {
+        atexit(RemovePendingOutputs);
+        registered = true;
+    }
+
+    sPendingCache = cache;
+
+    struct CacheFile *output = AddFile(&cache->outputs, &cache->numOutputs, path);
+
+    output->tempPath = GetTempPath(path);
+    return output->tempPath;
+}
+
+static void StoreOutput(struct ToolCache *cache, struct CacheFile *output, const unsigned char *data, size_t size)
+{
+    HashData(data, size, output->digest);
+
+    char *blobPath = GetCachePath(cache, output->digest, "");
+    FILE *fp = fopen(blobPath, "rb");
+
+    if (fp != NULL)
+    {
+        fclose(fp);
+    }
+    else
+    {
+        // Another run could be storing the same contents, so the temporary
+        // file is named after this run.
+        char *tempPath = Concat(blobPath, ".", cache->keyDigest);
+        char *dir = GetCacheSubdir(cache, output->digest);
+
+        MakeDirectories(dir);
+        free(dir);
+
+        if (!WriteFileAtomically(blobPath, tempPath, data, size))
+            DisableCache(cache);
+
+        free(tempPath);
+    }
+
+    free(blobPath);
+}
+
+static void StoreManifest(struct ToolCache *cache)
+{
+    size_t capacity = 1;
+
+    for (int i = 0; i < cache->numInputs; i++)
+        capacity += strlen(cache->inputs[i].path) + DIGEST_HEX_SIZE + sizeof("input  \n");
+
+    for (int i = 0; i < cache->numOutputs; i++)
+        capacity += strlen(cache->outputs[i].path) + DIGEST_HEX_SIZE + sizeof("output  \n");
+
+    char *manifest = (char *)Allocate(capacity);
+    size_t size = 0;
+
+    for (int i = 0; i < cache->numInputs; i++)
+        size += sprintf(manifest + size, "input %s %s\n", cache->inputs[i].digest, cache->inputs[i].path);
+
+    for (int i = 0; i < cache->numOutputs; i++)
+        size += sprintf(manifest + size, "output %s %s\n", cache->outputs[i].digest, cache->outputs[i].path);
+
+    char *manifestPath = GetCachePath(cache, cache->keyDigest, ".manifest");
+    char *tempPath = Concat(manifestPath, ".tmp", "");
+    char *dir = GetCacheSubdir(cache, cache->keyDigest);
+
+    MakeDirectories(dir);
+    free(dir);
+    WriteFileAtomically(manifestPath, tempPath, manifest, size);
+    free(tempPath);
+    free(manifestPath);
+    free(manifest);
+}
+
+void ToolCacheFinish(struct ToolCache *cache)
+{
+    bool store = cache->dir != NULL && cache->keyed && !cache->restored;
+
+    for (int i = 0; i < cache->numOutputs; i++)
+    {
+        struct CacheFile *output = &cache->outputs[i];
+        size_t size;
+        unsigned char *data = ReadFile(output->tempPath, &size);
+
+        if (data == NULL)
+        {
+            fprintf(stderr, "Failed to read \"%s\".\n", output->tempPath);
+            exit(1);
+        }
+
+        if (!ReplaceFile(output->tempPath, output->path))
+        {
+            fprintf(stderr, "Failed to rename \"%s\" to \"%s\".\n", output->tempPath, output->path);
+            exit(1);
+        }
+
+        if (store && cache->dir != NULL)
+            StoreOutput(cache, output, data, size);
+
+        free(data);
+    }
+
+    sPendingCache = NULL;
+
+    if (store && cache->dir != NULL)
+        StoreManifest(cache);
+
+    for (int i = 0; i < cache->numInputs; i++)
+        free(cache->inputs[i].path);
+
+    for (int i = 0; i < cache->numOutputs; i++)
+    {
+        free(cache->outputs[i].path);
+        free(cache->outputs[i].tempPath);
+    }
+
+    free(cache->inputs);
+    free(cache->outputs);
+    free(cache->key);
+    free(cache->dir);
+    free(cache);
+}
@@ -0,0 +1,52 @@
+#ifndef TOOLCACHE_H
+#define TOOLCACHE_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A content-addressed cache for the outputs of a tool run, shared by the
+// asset tools. A run is keyed by the contents of the tool's executable, its
+// arguments and the contents of its input files. The cache lives in the
+// directory named by the TOOLS_CACHE_DIR environment variable, and is off
+// when that isn't set.
+//
+// Outputs are written to a temporary file first and renamed over the real
+// output once the tool is done, so a failed run never leaves a partial file.
+// They are always replaced, even when their contents are unchanged: the cache
+// saves running the tool, not rebuilding what depends on its outputs.
+//
+// Usage:
+//
+//     struct ToolCache *cache = ToolCacheBegin(argc, argv);
+//     ToolCacheAddInput(cache, inputPath);
+//     if (!ToolCacheRestore(cache))
+//         Convert(inputPath, ToolCacheAddOutput(cache, outputPath));
+//     ToolCacheFinish(cache);
+//
+// Inputs added after ToolCacheRestore are files the tool only found out it
+// needed while running (such as included templates). They are recorded with
+// the cached outputs and checked again before those outputs are reused.
+
+struct ToolCache;
+
+struct ToolCache *ToolCacheBegin(int argc, char **argv);
+void ToolCacheAddInput(struct ToolCache *cache, const char *path);
+
+// Copies the outputs of an identical earlier run into place. Returns false if
+// there wasn't one, in which case the tool needs to run.
+bool ToolCacheRestore(struct ToolCache *cache);
+
+// Returns the path the tool should write the output at path to.
+const char *ToolCacheAddOutput(struct ToolCache *cache, const char *path);
+
+// Moves the outputs into place, stores them in the cache and frees cache.
+void ToolCacheFinish(struct ToolCache *cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TOOLCACHE_H